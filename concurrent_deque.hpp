@@ -0,0 +1,295 @@
+#ifndef MYDEQUE_CONCURRENT_H
+#define MYDEQUE_CONCURRENT_H
+
+#include "deque.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Small index of the calling thread, below kMaxThreads, for per-thread
+// records of concurrent containers. Released when the thread exits, so
+// indices are reused by later threads.
+class DequeThreadIndex {
+  public:
+    static constexpr int kMaxThreads = 128;
+
+    static int Get() {
+        // Plain int first: reading it needs no thread_local init guard
+        thread_local int index = -1;
+        if (index < 0) {
+            thread_local Holder holder;
+            index = holder.index;
+        }
+        return index;
+    }
+
+  private:
+    struct Holder {
+        int index{-1};
+
+        Holder() {
+            for (int i = 0; i < kMaxThreads; ++i) {
+                bool expected = false;
+                if (Claimed()[i].compare_exchange_strong(expected, true,
+                                                         std::memory_order_acquire)) {
+                    index = i;
+                    return;
+                }
+            }
+            throw std::runtime_error("DequeThreadIndex error: too many threads!");
+        }
+        ~Holder() {
+            Claimed()[index].store(false, std::memory_order_release);
+        }
+    };
+
+    static std::atomic<bool>* Claimed() {
+        static std::atomic<bool> claimed[kMaxThreads] = {};
+        return claimed;
+    }
+};
+
+// Unbounded multi-producer multi-consumer FIFO on linked segments of a
+// Deque block's size.
+//
+// A push takes a slot with fetch_add on the tail segment's index, builds the
+// value there and flips the slot state from empty to full. A pop takes a
+// slot the same way and swaps its state to taken. If the pop got there
+// first, the slot is dead and the push carries its value on to the next
+// slot. A segment whose indices are used up is unlinked by the consumer
+// that moved the head past it and freed through hazard pointers: each
+// thread announces the segments it works in, and a retired segment is
+// deleted once no announcement points to it.
+template<typename T, typename BlockPolicy = DequeDefaultBlock>
+class ConcurrentDeque {
+  public:
+    typedef T value_type;
+    typedef BlockPolicy block_policy;
+
+  private:
+    static constexpr int64_t kSegmentSize = BlockPolicy::template kElems<T>;
+    static constexpr int64_t kRetireBatch = 64;
+
+    enum SlotState : uint8_t { kEmpty, kFull, kTaken };
+
+    struct Slot {
+        std::atomic<uint8_t> state{kEmpty};
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        T* Value() noexcept {
+            return reinterpret_cast<T*>(storage);
+        }
+    };
+    struct Segment {
+        alignas(kDequeCacheLine) std::atomic<int64_t> push_index{0};
+        alignas(kDequeCacheLine) std::atomic<int64_t> pop_index{0};
+        std::atomic<Segment*> next{nullptr};
+        Slot slots[kSegmentSize];
+    };
+    // Hazard 0: segment being worked in, hazard 1: segment holding a value
+    // that is carried to the next slot. retired is touched by its thread only
+    struct alignas(kDequeCacheLine) ThreadRecord {
+        std::atomic<Segment*> hazards[2] = {};
+        std::vector<Segment*> retired;
+    };
+
+  public:
+    ConcurrentDeque() {
+        Segment* segment = new Segment;
+        head_.store(segment, std::memory_order_relaxed);
+        tail_.store(segment, std::memory_order_relaxed);
+    }
+    ConcurrentDeque(const ConcurrentDeque&) = delete;
+    ConcurrentDeque& operator=(const ConcurrentDeque&) = delete;
+    // No thread may use the deque any more
+    ~ConcurrentDeque() {
+        Segment* segment = head_.load(std::memory_order_acquire);
+        while (segment != nullptr) {
+            if constexpr (!std::is_trivially_destructible<T>::value) {
+                for (Slot& slot : segment->slots) {
+                    if (slot.state.load(std::memory_order_relaxed) == kFull) {
+                        slot.Value()->~T();
+                    }
+                }
+            }
+            delete std::exchange(segment, segment->next.load(std::memory_order_relaxed));
+        }
+        for (ThreadRecord& record : records_) {
+            for (Segment* retired : record.retired) {
+                delete retired;
+            }
+        }
+    }
+
+    void push_back(const T& val) {
+        emplace_back(val);
+    }
+    void push_back(T&& val) {
+        emplace_back(std::move(val));
+    }
+    template<typename... Args>
+    void emplace_back(Args&&... args) {
+        OperationGuard guard(Record());
+        while (true) {
+            Segment* tail = Protect(guard.record.hazards[0], tail_);
+            int64_t ind = tail->push_index.fetch_add(1);
+            if (ind >= kSegmentSize) {
+                AdvanceTail(tail);
+                continue;
+            }
+            Slot& slot = tail->slots[ind];
+            if (guard.carried == nullptr) {
+                ::new (static_cast<void*>(slot.Value())) T(std::forward<Args>(args)...);
+            } else {
+                ::new (static_cast<void*>(slot.Value())) T(std::move(*guard.carried));
+                std::exchange(guard.carried, nullptr)->~T();
+            }
+            uint8_t expected = kEmpty;
+            if (slot.state.compare_exchange_strong(expected, kFull)) {
+                return;
+            }
+            // A consumer gave up on the slot: keep its segment while the
+            // value waits there
+            guard.record.hazards[1].store(tail);
+            guard.carried = slot.Value();
+        }
+    }
+
+    // The oldest element, none if the deque is empty
+    std::optional<T> pop_front() {
+        OperationGuard guard(Record());
+        while (true) {
+            Segment* head = Protect(guard.record.hazards[0], head_);
+            Segment* next = head->next.load();
+            if (next == nullptr &&
+                    head->pop_index.load() >= head->push_index.load()) {
+                return std::nullopt;
+            }
+            int64_t ind = head->pop_index.fetch_add(1);
+            if (ind >= kSegmentSize) {
+                if (next == nullptr && (next = head->next.load()) == nullptr) {
+                    return std::nullopt;
+                }
+                // Tail never stays behind head: a retired segment must be
+                // unreachable
+                Segment* tail = head;
+                tail_.compare_exchange_strong(tail, next);
+                if (head_.compare_exchange_strong(head, next)) {
+                    guard.record.hazards[0].store(nullptr);
+                    Retire(guard.record, head);
+                }
+                continue;
+            }
+            Slot& slot = head->slots[ind];
+            if (slot.state.exchange(kTaken) != kFull) {
+                // Producer not there yet: the slot is dead, it will move on
+                continue;
+            }
+            // The slot is ours, its value is destroyed even if moving throws
+            guard.carried = slot.Value();
+            return std::optional<T>(std::move(*slot.Value()));
+        }
+    }
+
+    // Snapshot: may be stale as soon as it returns
+    bool empty() {
+        OperationGuard guard(Record());
+        Segment* head = Protect(guard.record.hazards[0], head_);
+        return head->next.load() == nullptr &&
+               head->pop_index.load() >= head->push_index.load();
+    }
+    static constexpr int64_t segment_size() noexcept {
+        return kSegmentSize;
+    }
+
+  private:
+    alignas(kDequeCacheLine) std::atomic<Segment*> head_{nullptr};
+    alignas(kDequeCacheLine) std::atomic<Segment*> tail_{nullptr};
+    ThreadRecord records_[DequeThreadIndex::kMaxThreads];
+
+    ThreadRecord& Record() {
+        return records_[DequeThreadIndex::Get()];
+    }
+    // Clears the thread's hazards when an operation ends and destroys the
+    // value it still owns (carried by a push that threw, or popped)
+    struct OperationGuard {
+        ThreadRecord& record;
+        T* carried{nullptr};
+
+        explicit OperationGuard(ThreadRecord& rec) noexcept
+                : record(rec) {}
+        OperationGuard(const OperationGuard&) = delete;
+        OperationGuard& operator=(const OperationGuard&) = delete;
+        ~OperationGuard() {
+            if (carried != nullptr) {
+                carried->~T();
+            }
+            record.hazards[0].store(nullptr, std::memory_order_release);
+            if (record.hazards[1].load(std::memory_order_relaxed) != nullptr) {
+                record.hazards[1].store(nullptr, std::memory_order_release);
+            }
+        }
+    };
+    // Announces the segment src points to, once the announcement is
+    // visible and src still points there, it can't be freed
+    static Segment* Protect(std::atomic<Segment*>& hazard, const std::atomic<Segment*>& src) {
+        Segment* segment = src.load();
+        while (true) {
+            hazard.store(segment);
+            Segment* again = src.load();
+            if (again == segment) {
+                return segment;
+            }
+            segment = again;
+        }
+    }
+    // Tail segment is used up: link a new one (or help whoever did)
+    void AdvanceTail(Segment* tail) {
+        if (tail != tail_.load()) {
+            return;
+        }
+        Segment* next = tail->next.load();
+        if (next == nullptr) {
+            Segment* segment = new Segment;
+            if (!tail->next.compare_exchange_strong(next, segment)) {
+                delete segment;
+                return;
+            }
+            next = segment;
+        }
+        tail_.compare_exchange_strong(tail, next);
+    }
+    void Retire(ThreadRecord& record, Segment* segment) {
+        record.retired.push_back(segment);
+        if (int64_t(record.retired.size()) < kRetireBatch) {
+            return;
+        }
+        std::vector<Segment*> hazards;
+        hazards.reserve(2 * DequeThreadIndex::kMaxThreads);
+        for (ThreadRecord& other : records_) {
+            for (std::atomic<Segment*>& hazard : other.hazards) {
+                if (Segment* protected_segment = hazard.load()) {
+                    hazards.push_back(protected_segment);
+                }
+            }
+        }
+        std::sort(hazards.begin(), hazards.end());
+        auto kept = std::partition(record.retired.begin(), record.retired.end(),
+                                   [&hazards](Segment* retired) {
+            return std::binary_search(hazards.begin(), hazards.end(), retired);
+        });
+        for (auto it = kept; it != record.retired.end(); ++it) {
+            delete *it;
+        }
+        record.retired.erase(kept, record.retired.end());
+    }
+};
+
+#endif /* MYDEQUE_CONCURRENT_H */
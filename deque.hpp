@@ -12,20 +12,128 @@
 #include <iterator>
 #include <stdexcept>
 #include <math.h>
+#include <memory>
+#include <type_traits>
 #include <utility>
 
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#define MY_DEQUE_HAS_SPAN
+#endif
+
+#if defined(__cpp_impl_three_way_comparison) && __has_include(<compare>)
+#include <compare>
+#define MY_DEQUE_HAS_THREE_WAY
+#endif
+
 #ifdef MY_DEQUE_DEBUG
 #include <iostream>
 #include <deque>
 #endif // MY_DEQUE_DEBUG
 
-template<typename T>
+// Block size policies: kElems<T> is the number of elements in one block
+struct DequeDefaultBlock {
+    template<typename T>
+    static constexpr int64_t kElems = sizeof(T) < 256 ? 4096 / sizeof(T) : 16;
+};
+// Block of (about) Bytes bytes, but never less than one element
+template<size_t Bytes>
+struct DequeBlockBytes {
+    template<typename T>
+    static constexpr int64_t kElems = Bytes / sizeof(T) > 0 ? Bytes / sizeof(T) : 1;
+};
+template<int64_t Elems>
+struct DequeBlockElems {
+    static_assert(Elems > 0, "DequeBlockElems: block must hold at least one element");
+
+    template<typename T>
+    static constexpr int64_t kElems = Elems;
+};
+
+constexpr int64_t DequeRoundUpPow2(int64_t val) {
+    int64_t res = 1;
+    while (res < val) {
+        res <<= 1;
+    }
+    return res;
+}
+// Rounds Policy's block up to a power of two: indexing becomes shift & mask
+template<typename Policy>
+struct DequePow2Block {
+    template<typename T>
+    static constexpr int64_t kElems = DequeRoundUpPow2(Policy::template kElems<T>);
+};
+
+// Splits an element offset (relative to some block begin) into block and
+// in-block parts, rounding towards minus infinity for negative offsets
+template<int64_t BuffSize>
+struct DequeBlockMath {
+    static constexpr bool kIsPow2 = (BuffSize & (BuffSize - 1)) == 0;
+    static constexpr ptrdiff_t kMask = BuffSize - 1;
+    static constexpr int kShift = [] {
+        int shift = 0;
+        while ((int64_t(1) << shift) < BuffSize) {
+            ++shift;
+        }
+        return shift;
+    }();
+
+    static constexpr ptrdiff_t NodeOffset(ptrdiff_t offset) noexcept {
+        if constexpr (kIsPow2) {
+            // Arithmetic shift is floor division (gcc & clang)
+            return offset >> kShift;
+        } else {
+            return (offset >= 0) ? offset / BuffSize
+                                 : -ptrdiff_t((-offset - 1) / BuffSize) - 1;
+        }
+    }
+    static constexpr ptrdiff_t InNodeOffset(ptrdiff_t offset) noexcept {
+        if constexpr (kIsPow2) {
+            return offset & kMask;
+        } else {
+            return offset - NodeOffset(offset) * BuffSize;
+        }
+    }
+};
+
+// Allocator::construct may do more than placement new
+template<typename Alloc, typename T, typename = void>
+struct DequeAllocHasConstruct : std::false_type {};
+template<typename Alloc, typename T>
+struct DequeAllocHasConstruct<Alloc, T, std::void_t<decltype(std::declval<Alloc&>().construct(
+                            std::declval<T*>(), std::declval<const T&>()))>>
+        : std::true_type {};
+
+template<typename T, typename Allocator = std::allocator<T>,
+         typename BlockPolicy = DequeDefaultBlock>
 class Deque;
 
-template<typename T, typename Ptr, typename Ref>
+struct DequeIteratorAccess;
+
+// Deque(size, deque_default_init): elements are default-initialized,
+// trivial types are left uninitialized
+struct DequeDefaultInit {
+    explicit DequeDefaultInit() = default;
+};
+inline constexpr DequeDefaultInit deque_default_init{};
+
+// Fields written by different threads (concurrent deques) are kept this
+// far apart, so they never share a cache line
+inline constexpr size_t kDequeCacheLine = 64;
+
+struct DequeBlockStats {
+    int64_t allocated{0};   // Blocks taken from the allocator
+    int64_t released{0};    // Blocks given back to the allocator
+    int64_t reused{0};      // Blocks served from the spare cache
+    int64_t cached{0};      // Blocks in the spare cache right now
+};
+
+template<typename T, typename Ptr, typename Ref, int64_t BuffSize>
 class DequeIterator
         : public std::iterator<std::random_access_iterator_tag, T> {
-    friend class Deque<T>;
+    template<typename, typename, typename>
+    friend class Deque;
+    friend struct DequeIteratorAccess;
   public:
     typedef std::random_access_iterator_tag iterator_category;
     typedef T value_type;
@@ -34,7 +142,10 @@ class DequeIterator
 
     typedef ptrdiff_t difference_type;
     typedef pointer* map_pointer;
-    typedef DequeIterator<T, Ptr, Ref> self;
+    typedef DequeIterator<T, Ptr, Ref, BuffSize> self;
+    typedef DequeBlockMath<BuffSize> block_math;
+
+    static constexpr difference_type kBuffSize = BuffSize;
 
   public:
     DequeIterator() = default;
@@ -47,43 +158,20 @@ class DequeIterator
         owner_node_ = nullptr;
     }
 
-    DequeIterator(const DequeIterator& it) noexcept
-            : curr_(it.curr_)
-            , first_(it.first_)
-            , last_(it.last_)
-            , owner_node_(it.owner_node_) {}
-    DequeIterator(DequeIterator&& it) noexcept
-            : curr_(it.curr_)
-            , first_(it.first_)
-            , last_(it.last_)
-            , owner_node_(it.owner_node_) {
-        it.Clear();
-    }
-    self& operator=(const self& it) noexcept {
-        curr_ = it.curr_;
-        first_ = it.first_;
-        last_ = it.last_;
-        owner_node_ = it.owner_node_;
-        return *this;
-    }
-	self& operator=(self&& it) noexcept {
-        curr_ = std::exchange(it.curr_, nullptr);
-        first_ = std::exchange(it.first_, nullptr);
-        last_ = std::exchange(it.last_, nullptr);
-        owner_node_ = std::exchange(it.owner_node_, nullptr);
-        return *this;
-    }
+    // Plain copies: iterators are trivially copyable
+    DequeIterator(const DequeIterator& it) noexcept = default;
+    self& operator=(const self& it) noexcept = default;
 
-    // NON-CONST -> CONST
-    DequeIterator(T* ptr, T** owner) noexcept
-            : curr_(ptr)
-            , first_(*owner)
-            , last_(*owner + Deque<T>::kInitBuffSize)
-            , owner_node_(nullptr) {
-        owner_node_ = const_cast<map_pointer>(owner);
-    }
-    constexpr operator DequeIterator<T, const T*, const T&>() const {
-        return DequeIterator<T, const T*, const T&>(curr_, owner_node_);
+    // NON-CONST -> CONST: pointers are copied, the map is not read (an
+    // iterator of a deque without map is all null)
+    DequeIterator(T* curr, T* first, T* last, T** owner) noexcept
+            : curr_(curr)
+            , first_(first)
+            , last_(last)
+            , owner_node_(const_cast<map_pointer>(owner)) {}
+    constexpr operator DequeIterator<T, const T*, const T&, BuffSize>() const {
+        return DequeIterator<T, const T*, const T&, BuffSize>(curr_, first_, last_,
+                                                              owner_node_);
     }
 
     self& operator++() noexcept {
@@ -102,20 +190,27 @@ class DequeIterator
         --curr_;
         return *this;
     }
+    self operator++(int) noexcept {
+        self res = *this;
+        ++*this;
+        return res;
+    }
+    self operator--(int) noexcept {
+        self res = *this;
+        --*this;
+        return res;
+    }
     self& operator+=(const difference_type val) noexcept {
         difference_type offset = val + (curr_ - first_);
         // Same node
-        if (offset >= 0 && offset < difference_type(Deque<T>::kInitBuffSize)) {
+        if (offset >= 0 && offset < kBuffSize) {
             curr_ += val;
             return *this;
         }
 
         // Other node
-        difference_type node_offset = (offset > 0)
-                    ? offset / difference_type(Deque<T>::kInitBuffSize)
-                    : -difference_type((-offset - 1) / Deque<T>::kInitBuffSize) - 1;
-        SetOwnerNode(owner_node_ + node_offset);
-        curr_ = first_ + (offset - node_offset * difference_type(Deque<T>::kInitBuffSize));
+        SetOwnerNode(owner_node_ + block_math::NodeOffset(offset));
+        curr_ = first_ + block_math::InNodeOffset(offset);
         return *this;
     }
     self& operator-=(const difference_type val) noexcept {
@@ -125,37 +220,38 @@ class DequeIterator
         self res = *this;
         return res += val;
     }
+    friend self operator+(const difference_type val, const self& it) noexcept {
+        return it + val;
+    }
     self operator-(const difference_type val) const noexcept {
         self res = *this;
         return res -= val;
     }
     
     difference_type operator-(const DequeIterator& it) const noexcept {
-        // Also works if nodes (!) are the same
-        return ((owner_node_ - it.owner_node_ - 1) * 
-                                difference_type(Deque<T>::kInitBuffSize)) +
-               (curr_ - first_) + (it.last_ - it.curr_);
+        // Also works if nodes (!) are the same, and gives 0 for two
+        // null iterators (deque without map)
+        return ((owner_node_ - it.owner_node_) * kBuffSize) +
+               (curr_ - first_) - (it.curr_ - it.first_);
     }
     
-    value_type operator*() const {
+    reference operator*() const {
         if (curr_ == nullptr) {
             throw std::out_of_range("Iterator index out of range.");
         }
         return *curr_;
     }
-    reference operator*() {
-        if (curr_ == nullptr) {
-            throw std::out_of_range("Iterator index out of range.");
-        }
-        return *curr_;
-    }
-    pointer operator->() {
+    pointer operator->() const {
         if (curr_ == nullptr) {
             throw std::out_of_range("Iterator index out of range.");
         }
         return curr_;
     }
 
+    reference operator[](difference_type ind) const {
+        return *(*this + ind);
+    }
+
     bool operator==(const self& it) const noexcept {
         return owner_node_ == it.owner_node_ && curr_ == it.curr_;
     }
@@ -188,31 +284,650 @@ class DequeIterator
     void SetOwnerNode(map_pointer new_node) {
         owner_node_ = new_node;
         first_ = *new_node;
-        last_ = first_ + Deque<T>::kInitBuffSize;
+        last_ = first_ + kBuffSize;
     }
-    
-    reference operator[](difference_type ind) const {
+};
+
+// Map node + in-block offset (16 bytes instead of 32): cheaper to copy
+// and to keep in registers, dereference reads the map
+template<typename T, typename Ptr, typename Ref, int64_t BuffSize>
+class DequeCompactIterator {
+    template<typename, typename, typename>
+    friend class Deque;
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef Ptr pointer;
+    typedef Ref reference;
+
+    typedef ptrdiff_t difference_type;
+    typedef pointer* map_pointer;
+    typedef DequeCompactIterator<T, Ptr, Ref, BuffSize> self;
+    typedef DequeBlockMath<BuffSize> block_math;
+
+    static constexpr difference_type kBuffSize = BuffSize;
+
+  public:
+    DequeCompactIterator() = default;
+    DequeCompactIterator(T** node, difference_type offset) noexcept
+            : node_(const_cast<map_pointer>(node))
+            , offset_(offset) {}
+
+    // NON-CONST -> CONST
+    constexpr operator DequeCompactIterator<T, const T*, const T&, BuffSize>() const {
+        return DequeCompactIterator<T, const T*, const T&, BuffSize>(
+                                        const_cast<T**>(node_), offset_);
+    }
+
+    self& operator++() noexcept {
+        if (++offset_ == kBuffSize) {
+            ++node_;
+            offset_ = 0;
+        }
+        return *this;
+    }
+    self& operator--() noexcept {
+        if (offset_-- == 0) {
+            --node_;
+            offset_ = kBuffSize - 1;
+        }
+        return *this;
+    }
+    self operator++(int) noexcept {
+        self res = *this;
+        ++*this;
+        return res;
+    }
+    self operator--(int) noexcept {
+        self res = *this;
+        --*this;
+        return res;
+    }
+    self& operator+=(const difference_type val) noexcept {
+        difference_type offset = offset_ + val;
+        node_ += block_math::NodeOffset(offset);
+        offset_ = block_math::InNodeOffset(offset);
+        return *this;
+    }
+    self& operator-=(const difference_type val) noexcept {
+        return *this += -val;
+    }
+    self operator+(const difference_type val) const noexcept {
+        self res = *this;
+        return res += val;
+    }
+    friend self operator+(const difference_type val, const self& it) noexcept {
+        return it + val;
+    }
+    self operator-(const difference_type val) const noexcept {
+        self res = *this;
+        return res -= val;
+    }
+    difference_type operator-(const self& it) const noexcept {
+        return (node_ - it.node_) * kBuffSize + (offset_ - it.offset_);
+    }
+
+    reference operator*() const noexcept {
+        return (*node_)[offset_];
+    }
+    pointer operator->() const noexcept {
+        return *node_ + offset_;
+    }
+    reference operator[](difference_type ind) const noexcept {
         return *(*this + ind);
     }
+
+    bool operator==(const self& it) const noexcept {
+        return node_ == it.node_ && offset_ == it.offset_;
+    }
+    bool operator!=(const self& it) const noexcept {
+        return !(*this == it);
+    }
+    bool operator<(const self& it) const noexcept {
+        return (node_ == it.node_)? (offset_ < it.offset_) : (node_ < it.node_);
+    }
+    bool operator>(const self& it) const noexcept {
+        return it < *this;
+    }
+    bool operator<=(const self& it) const noexcept {
+        return !(it < *this);
+    }
+    bool operator>=(const self& it) const noexcept {
+        return !(*this < it);
+    }
+
+  private:
+    map_pointer node_{nullptr};
+    difference_type offset_{0};
+};
+
+// Contiguous piece of a deque (one block or a part of it)
+template<typename T>
+class DequeSpan {
+  public:
+    typedef T element_type;
+    typedef typename std::remove_cv<T>::type value_type;
+    typedef T* pointer;
+    typedef T& reference;
+    typedef T* iterator;
+
+  public:
+    DequeSpan() = default;
+    DequeSpan(T* data, int64_t size) noexcept
+            : data_(data)
+            , size_(size) {}
+    // DequeSpan<T> -> DequeSpan<const T>
+    template<typename U, typename = typename std::enable_if<
+                                    std::is_convertible<U*, T*>::value>::type>
+    DequeSpan(const DequeSpan<U>& other) noexcept
+            : data_(other.data())
+            , size_(other.size()) {}
+
+    #ifdef MY_DEQUE_HAS_SPAN
+    operator std::span<T>() const noexcept {
+        return std::span<T>(data_, size_t(size_));
+    }
+    #endif // MY_DEQUE_HAS_SPAN
+
+    pointer data() const noexcept {
+        return data_;
+    }
+    int64_t size() const noexcept {
+        return size_;
+    }
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+    iterator begin() const noexcept {
+        return data_;
+    }
+    iterator end() const noexcept {
+        return data_ + size_;
+    }
+    reference operator[](int64_t ind) const noexcept {
+        return data_[ind];
+    }
+
+  private:
+    pointer data_{nullptr};
+    int64_t size_{0};
+};
+
+// Range of DequeSpan<T> from [first, last) of a deque, one span per block
+template<typename T, int64_t BuffSize>
+class DequeSegmentRange {
+  public:
+    typedef T* const* map_pointer;
+
+    class iterator {
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef DequeSpan<T> value_type;
+        typedef DequeSpan<T> reference;
+        typedef void pointer;
+        typedef ptrdiff_t difference_type;
+
+      public:
+        iterator() = default;
+        iterator(map_pointer node, const DequeSegmentRange* range) noexcept
+                : node_(node)
+                , range_(range) {}
+
+        DequeSpan<T> operator*() const noexcept {
+            T* first = (node_ == range_->first_node_) ? range_->first_ : *node_;
+            T* last = (node_ == range_->last_node_) ? range_->last_ : *node_ + BuffSize;
+            return DequeSpan<T>(first, last - first);
+        }
+        iterator& operator++() noexcept {
+            ++node_;
+            return *this;
+        }
+        iterator operator++(int) noexcept {
+            iterator res = *this;
+            ++node_;
+            return res;
+        }
+        bool operator==(const iterator& it) const noexcept {
+            return node_ == it.node_;
+        }
+        bool operator!=(const iterator& it) const noexcept {
+            return node_ != it.node_;
+        }
+
+      private:
+        map_pointer node_{nullptr};
+        const DequeSegmentRange* range_{nullptr};
+    };
+
+  public:
+    DequeSegmentRange(map_pointer first_node, T* first,
+                      map_pointer last_node, T* last) noexcept
+            : first_node_(first_node)
+            , first_(first)
+            , last_node_(last_node)
+            , last_(last) {}
+
+    iterator begin() const noexcept {
+        return iterator(first_node_, this);
+    }
+    // Empty tail block (last_ at its beginning) gives no span, neither
+    // does a deque without map
+    iterator end() const noexcept {
+        if (last_node_ == nullptr) {
+            return iterator(last_node_, this);
+        }
+        return iterator(last_node_ + ((last_ != *last_node_) ? 1 : 0), this);
+    }
+
+  private:
+    map_pointer first_node_;
+    T* first_;
+    map_pointer last_node_;
+    T* last_;
+};
+
+// Block level view of DequeIterator for deque_algo
+struct DequeIteratorAccess {
+    template<typename Iter>
+    static typename Iter::pointer Curr(const Iter& it) noexcept {
+        return it.curr_;
+    }
+    // Elements left in it's block starting from it
+    template<typename Iter>
+    static ptrdiff_t BlockTail(const Iter& it) noexcept {
+        return it.last_ - it.curr_;
+    }
+    // Elements in it's block before it
+    template<typename Iter>
+    static ptrdiff_t BlockHead(const Iter& it) noexcept {
+        return it.curr_ - it.first_;
+    }
 };
 
+// Segment-aware versions of <algorithm> / <numeric> for deque iterators:
+// they work block to block on raw pointers instead of stepping
+// DequeIterator element by element
+namespace deque_algo {
+namespace detail {
+
+// Calls func(block_ptr, len) for consecutive pieces of [it, it + n),
+// stops early when func returns false
+template<typename Iter, typename Func>
+void ForwardPieces(Iter it, ptrdiff_t n, Func&& func) {
+    while (n > 0) {
+        ptrdiff_t len = std::min(n, DequeIteratorAccess::BlockTail(it));
+        if (!func(DequeIteratorAccess::Curr(it), len)) {
+            return;
+        }
+        n -= len;
+        if (n > 0) {
+            it += len;
+        }
+    }
+}
+// The same for [last - n, last), pieces go from back to front
+template<typename Iter, typename Func>
+void BackwardPieces(Iter last, ptrdiff_t n, Func&& func) {
+    while (n > 0) {
+        ptrdiff_t head = DequeIteratorAccess::BlockHead(last);
+        if (head == 0) {
+            // last is at the beginning of a block: go to the previous one
+            --last;
+            head = DequeIteratorAccess::BlockHead(last) + 1;
+            ++last;
+        }
+        ptrdiff_t len = std::min(n, head);
+        func(DequeIteratorAccess::Curr(last - 1) + 1 - len, len);
+        n -= len;
+        if (n > 0) {
+            last -= len;
+        }
+    }
+}
+
+// Bytes equal <=> values equal: scalars without padding bits (not float);
+// class types are excluded, their operator== may compare less than all bytes
+template<typename T>
+struct IsBitwiseComparable {
+    static constexpr bool value = std::has_unique_object_representations<T>::value &&
+                                  !std::is_class<T>::value;
+};
+template<typename T>
+bool EqualPointers(const T* first1, const T* last1, const T* first2) {
+    if constexpr (IsBitwiseComparable<T>::value) {
+        return std::memcmp(first1, first2, (last1 - first1) * sizeof(T)) == 0;
+    } else {
+        return std::equal(first1, last1, first2);
+    }
+}
+// Offset of the first mismatch in [first1, last1), last1 - first1 if none
+template<typename T>
+ptrdiff_t MismatchPointers(const T* first1, const T* last1, const T* first2) {
+    if constexpr (IsBitwiseComparable<T>::value) {
+        if (std::memcmp(first1, first2, (last1 - first1) * sizeof(T)) == 0) {
+            return last1 - first1;
+        }
+    }
+    return std::mismatch(first1, last1, first2).first - first1;
+}
+
+// Raw pointer pieces: memmove for trivially copyable T
 template<typename T>
+T* CopyPointers(const T* first, const T* last, T* dest) {
+    if constexpr (std::is_trivially_copyable<T>::value) {
+        std::memmove(static_cast<void*>(dest), first, (last - first) * sizeof(T));
+        return dest + (last - first);
+    } else {
+        return std::copy(first, last, dest);
+    }
+}
+template<typename T>
+T* CopyBackwardPointers(const T* first, const T* last, T* dest_last) {
+    if constexpr (std::is_trivially_copyable<T>::value) {
+        std::memmove(static_cast<void*>(dest_last - (last - first)), first,
+                     (last - first) * sizeof(T));
+        return dest_last - (last - first);
+    } else {
+        return std::copy_backward(first, last, dest_last);
+    }
+}
+template<typename T>
+T* MovePointers(T* first, T* last, T* dest) {
+    if constexpr (std::is_trivially_copyable<T>::value) {
+        return CopyPointers<T>(first, last, dest);
+    } else {
+        return std::move(first, last, dest);
+    }
+}
+template<typename T>
+T* MoveBackwardPointers(T* first, T* last, T* dest_last) {
+    if constexpr (std::is_trivially_copyable<T>::value) {
+        return CopyBackwardPointers<T>(first, last, dest_last);
+    } else {
+        return std::move_backward(first, last, dest_last);
+    }
+}
+
+// Copies (moves) pointer piece [first, last) into any output iterator,
+// deque destinations are split into their blocks
+template<typename T, typename OutputIt>
+OutputIt CopyPiece(const T* first, const T* last, OutputIt out) {
+    return std::copy(first, last, out);
+}
+template<typename T, int64_t B>
+DequeIterator<T, T*, T&, B> CopyPiece(const T* first, const T* last,
+                                      DequeIterator<T, T*, T&, B> out) {
+    const T* source = first;
+    ForwardPieces(out, last - first, [&source](T* dest, ptrdiff_t len) {
+        CopyPointers<T>(source, source + len, dest);
+        source += len;
+        return true;
+    });
+    return out + (last - first);
+}
+template<typename T, typename OutputIt>
+OutputIt MovePiece(T* first, T* last, OutputIt out) {
+    return std::move(first, last, out);
+}
+template<typename T, int64_t B>
+DequeIterator<T, T*, T&, B> MovePiece(T* first, T* last, DequeIterator<T, T*, T&, B> out) {
+    T* source = first;
+    ForwardPieces(out, last - first, [&source](T* dest, ptrdiff_t len) {
+        MovePointers<T>(source, source + len, dest);
+        source += len;
+        return true;
+    });
+    return out + (last - first);
+}
+template<typename T, typename BidirIt>
+BidirIt CopyBackwardPiece(const T* first, const T* last, BidirIt dest_last) {
+    return std::copy_backward(first, last, dest_last);
+}
+template<typename T, int64_t B>
+DequeIterator<T, T*, T&, B> CopyBackwardPiece(const T* first, const T* last,
+                                              DequeIterator<T, T*, T&, B> dest_last) {
+    const T* source_last = last;
+    BackwardPieces(dest_last, last - first, [&source_last](T* dest, ptrdiff_t len) {
+        CopyBackwardPointers<T>(source_last - len, source_last, dest + len);
+        source_last -= len;
+    });
+    return dest_last - (last - first);
+}
+template<typename T, typename BidirIt>
+BidirIt MoveBackwardPiece(T* first, T* last, BidirIt dest_last) {
+    return std::move_backward(first, last, dest_last);
+}
+template<typename T, int64_t B>
+DequeIterator<T, T*, T&, B> MoveBackwardPiece(T* first, T* last,
+                                              DequeIterator<T, T*, T&, B> dest_last) {
+    T* source_last = last;
+    BackwardPieces(dest_last, last - first, [&source_last](T* dest, ptrdiff_t len) {
+        MoveBackwardPointers<T>(source_last - len, source_last, dest + len);
+        source_last -= len;
+    });
+    return dest_last - (last - first);
+}
+
+} // namespace detail
+
+// Forward copy / move handle overlapping ranges if dest is before first,
+// backward ones if dest_last is after last (like std::)
+template<typename T, typename Ptr, typename Ref, int64_t B, typename OutputIt>
+OutputIt copy(DequeIterator<T, Ptr, Ref, B> first, DequeIterator<T, Ptr, Ref, B> last,
+              OutputIt out) {
+    detail::ForwardPieces(first, last - first, [&out](Ptr piece, ptrdiff_t len) {
+        out = detail::CopyPiece<T>(piece, piece + len, out);
+        return true;
+    });
+    return out;
+}
+template<typename T, int64_t B, typename OutputIt>
+OutputIt move(DequeIterator<T, T*, T&, B> first, DequeIterator<T, T*, T&, B> last,
+              OutputIt out) {
+    detail::ForwardPieces(first, last - first, [&out](T* piece, ptrdiff_t len) {
+        out = detail::MovePiece<T>(piece, piece + len, out);
+        return true;
+    });
+    return out;
+}
+template<typename T, typename Ptr, typename Ref, int64_t B, typename BidirIt>
+BidirIt copy_backward(DequeIterator<T, Ptr, Ref, B> first,
+                      DequeIterator<T, Ptr, Ref, B> last, BidirIt dest_last) {
+    detail::BackwardPieces(last, last - first, [&dest_last](Ptr piece, ptrdiff_t len) {
+        dest_last = detail::CopyBackwardPiece<T>(piece, piece + len, dest_last);
+    });
+    return dest_last;
+}
+template<typename T, int64_t B, typename BidirIt>
+BidirIt move_backward(DequeIterator<T, T*, T&, B> first,
+                      DequeIterator<T, T*, T&, B> last, BidirIt dest_last) {
+    detail::BackwardPieces(last, last - first, [&dest_last](T* piece, ptrdiff_t len) {
+        dest_last = detail::MoveBackwardPiece<T>(piece, piece + len, dest_last);
+    });
+    return dest_last;
+}
+
+template<typename T, int64_t B>
+void fill(DequeIterator<T, T*, T&, B> first, DequeIterator<T, T*, T&, B> last,
+          const T& val) {
+    detail::ForwardPieces(first, last - first, [&val](T* piece, ptrdiff_t len) {
+        std::fill(piece, piece + len, val);
+        return true;
+    });
+}
+
+template<typename T, typename Ptr, typename Ref, int64_t B, typename U>
+DequeIterator<T, Ptr, Ref, B> find(DequeIterator<T, Ptr, Ref, B> first,
+                                   DequeIterator<T, Ptr, Ref, B> last, const U& val) {
+    ptrdiff_t found = last - first;
+    ptrdiff_t passed = 0;
+    detail::ForwardPieces(first, last - first, [&](Ptr piece, ptrdiff_t len) {
+        Ptr it = std::find(piece, piece + len, val);
+        if (it != piece + len) {
+            found = passed + (it - piece);
+            return false;
+        }
+        passed += len;
+        return true;
+    });
+    return first + found;
+}
+template<typename T, typename Ptr, typename Ref, int64_t B, typename U>
+ptrdiff_t count(DequeIterator<T, Ptr, Ref, B> first,
+                DequeIterator<T, Ptr, Ref, B> last, const U& val) {
+    ptrdiff_t res = 0;
+    detail::ForwardPieces(first, last - first, [&](Ptr piece, ptrdiff_t len) {
+        res += std::count(piece, piece + len, val);
+        return true;
+    });
+    return res;
+}
+
+template<typename T, typename Ptr, typename Ref, int64_t B, typename Acc, typename BinaryOp>
+Acc accumulate(DequeIterator<T, Ptr, Ref, B> first, DequeIterator<T, Ptr, Ref, B> last,
+               Acc init, BinaryOp op) {
+    detail::ForwardPieces(first, last - first, [&](Ptr piece, ptrdiff_t len) {
+        for (Ptr it = piece; it != piece + len; ++it) {
+            init = op(std::move(init), *it);
+        }
+        return true;
+    });
+    return init;
+}
+template<typename T, typename Ptr, typename Ref, int64_t B, typename Acc>
+Acc accumulate(DequeIterator<T, Ptr, Ref, B> first, DequeIterator<T, Ptr, Ref, B> last,
+               Acc init) {
+    detail::ForwardPieces(first, last - first, [&](Ptr piece, ptrdiff_t len) {
+        for (Ptr it = piece; it != piece + len; ++it) {
+            init = std::move(init) + *it;
+        }
+        return true;
+    });
+    return init;
+}
+
+template<typename T, typename Ptr, typename Ref, int64_t B, typename InputIt>
+bool equal(DequeIterator<T, Ptr, Ref, B> first1, DequeIterator<T, Ptr, Ref, B> last1,
+           InputIt first2) {
+    bool res = true;
+    detail::ForwardPieces(first1, last1 - first1, [&](Ptr piece, ptrdiff_t len) {
+        res = std::equal(piece, piece + len, first2);
+        std::advance(first2, len);
+        return res;
+    });
+    return res;
+}
+// Both ranges are deques: pieces are cut at the block borders of both
+template<typename T, typename Ptr1, typename Ref1, typename Ptr2, typename Ref2,
+         int64_t B1, int64_t B2>
+bool equal(DequeIterator<T, Ptr1, Ref1, B1> first1, DequeIterator<T, Ptr1, Ref1, B1> last1,
+           DequeIterator<T, Ptr2, Ref2, B2> first2) {
+    bool res = true;
+    detail::ForwardPieces(first1, last1 - first1, [&](Ptr1 piece, ptrdiff_t len) {
+        detail::ForwardPieces(first2, len, [&](Ptr2 other, ptrdiff_t other_len) {
+            res = detail::EqualPointers<T>(piece, piece + other_len, other);
+            piece += other_len;
+            return res;
+        });
+        first2 += len;
+        return res;
+    });
+    return res;
+}
+
+// Both ranges are deques, [first2, first2 + (last1 - first1)) must be valid
+template<typename T, typename Ptr1, typename Ref1, typename Ptr2, typename Ref2,
+         int64_t B1, int64_t B2>
+std::pair<DequeIterator<T, Ptr1, Ref1, B1>, DequeIterator<T, Ptr2, Ref2, B2>> mismatch(
+        DequeIterator<T, Ptr1, Ref1, B1> first1, DequeIterator<T, Ptr1, Ref1, B1> last1,
+        DequeIterator<T, Ptr2, Ref2, B2> first2) {
+    ptrdiff_t passed = 0;
+    bool found = false;
+    detail::ForwardPieces(first1, last1 - first1, [&](Ptr1 piece, ptrdiff_t len) {
+        detail::ForwardPieces(first2 + passed, len, [&](Ptr2 other, ptrdiff_t other_len) {
+            ptrdiff_t same = detail::MismatchPointers<T>(piece, piece + other_len, other);
+            passed += same;
+            piece += other_len;
+            found = same != other_len;
+            return !found;
+        });
+        return !found;
+    });
+    return {first1 + passed, first2 + passed};
+}
+template<typename T, typename Ptr1, typename Ref1, typename Ptr2, typename Ref2,
+         int64_t B1, int64_t B2>
+bool lexicographical_compare(DequeIterator<T, Ptr1, Ref1, B1> first1,
+                             DequeIterator<T, Ptr1, Ref1, B1> last1,
+                             DequeIterator<T, Ptr2, Ref2, B2> first2,
+                             DequeIterator<T, Ptr2, Ref2, B2> last2) {
+    ptrdiff_t len = std::min(last1 - first1, last2 - first2);
+    auto diff = deque_algo::mismatch(first1, first1 + len, first2);
+    if (diff.first - first1 != len) {
+        return *diff.first < *diff.second;
+    }
+    return len < last2 - first2;
+}
+#ifdef MY_DEQUE_HAS_THREE_WAY
+template<typename T, typename Ptr1, typename Ref1, typename Ptr2, typename Ref2,
+         int64_t B1, int64_t B2>
+auto lexicographical_compare_three_way(DequeIterator<T, Ptr1, Ref1, B1> first1,
+                                       DequeIterator<T, Ptr1, Ref1, B1> last1,
+                                       DequeIterator<T, Ptr2, Ref2, B2> first2,
+                                       DequeIterator<T, Ptr2, Ref2, B2> last2)
+        -> std::compare_three_way_result_t<T> {
+    ptrdiff_t len = std::min(last1 - first1, last2 - first2);
+    auto diff = deque_algo::mismatch(first1, first1 + len, first2);
+    if (diff.first - first1 != len) {
+        return *diff.first <=> *diff.second;
+    }
+    return (last1 - first1) <=> (last2 - first2);
+}
+#endif // MY_DEQUE_HAS_THREE_WAY
+
+} // namespace deque_algo
+
+template<typename T, typename Allocator, typename BlockPolicy>
 class Deque {
-    friend class DequeIterator<T, T*, T&>;
-    friend class DequeIterator<T, const T*, const T&>;
+    static constexpr int64_t kInitBuffSize = BlockPolicy::template kElems<T>;
+    static_assert(kInitBuffSize > 0, "Deque: block must hold at least one element");
+
   public:
+    typedef T value_type;
+    typedef Allocator allocator_type;
+    typedef BlockPolicy block_policy;
     typedef T* pointer;
     typedef T& reference;
 
-    typedef DequeIterator<T, T*, T&> iterator;
-    typedef DequeIterator<T, const T*, const T&> const_iterator;
+    typedef DequeIterator<T, T*, T&, kInitBuffSize> iterator;
+    typedef DequeIterator<T, const T*, const T&, kInitBuffSize> const_iterator;
     typedef std::reverse_iterator<iterator> reverse_iterator;
     typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+    typedef DequeCompactIterator<T, T*, T&, kInitBuffSize> compact_iterator;
+    typedef DequeCompactIterator<T, const T*, const T&, kInitBuffSize> const_compact_iterator;
+    typedef DequeSpan<T> segment;
+    typedef DequeSpan<const T> const_segment;
+    typedef DequeSegmentRange<T, kInitBuffSize> segment_range;
+    typedef DequeSegmentRange<const T, kInitBuffSize> const_segment_range;
 
     typedef ptrdiff_t difference_type;
     typedef pointer* map_pointer;
-    std::allocator<T> data_allocator;
-    std::allocator<pointer> map_allocator;
+
+  private:
+    typedef DequeBlockMath<kInitBuffSize> block_math;
+    typedef std::allocator_traits<Allocator> data_traits;
+    typedef typename data_traits::template rebind_alloc<pointer> map_allocator_type;
+    typedef std::allocator_traits<map_allocator_type> map_traits;
+
+    static_assert(std::is_same<typename data_traits::value_type, T>::value,
+                  "Deque: Allocator::value_type must be T");
+    static_assert(std::is_same<typename data_traits::pointer, pointer>::value,
+                  "Deque: only allocators with raw pointers are supported");
+
+    // Elements may be copied into raw block memory with memcpy
+    static constexpr bool kBitwiseCopy = std::is_trivially_copyable<T>::value &&
+                (std::is_same<Allocator, std::allocator<T>>::value ||
+                 !DequeAllocHasConstruct<Allocator, T>::value);
 
   public:
     #ifdef MY_DEQUE_DEBUG
@@ -224,145 +939,349 @@ class Deque {
     }
     #endif // MY_DEQUE_DEBUG
 
+    // Allocates nothing: map and first block come with the first insertion
     Deque() noexcept
-            : start_()
+            : Deque(Allocator()) {}
+    explicit Deque(const Allocator& alloc) noexcept
+            : data_allocator_(alloc)
+            , map_allocator_(data_allocator_)
+            , start_()
+            , finish_()
+            , map_(nullptr) {}
+    // Elements are value-initialized
+    Deque(int64_t size, const Allocator& alloc = Allocator())
+            : data_allocator_(alloc)
+            , map_allocator_(data_allocator_)
+            , start_()
             , finish_()
             , map_(nullptr) {
-        CreateMapAndNodes(0);
+        CreateMapAndNodes(size);
+        try {
+            ConstructValueRange(start_, size);
+        } catch (...) {
+            ReleaseRawData();
+            throw;
+        }
     }
-    Deque(int64_t size) noexcept
-            : start_()
+    Deque(int64_t size, DequeDefaultInit, const Allocator& alloc = Allocator())
+            : data_allocator_(alloc)
+            , map_allocator_(data_allocator_)
+            , start_()
             , finish_()
             , map_(nullptr) {
         CreateMapAndNodes(size);
+        if constexpr (!kBitwiseCopy || !std::is_trivially_default_constructible<T>::value) {
+            try {
+                ConstructValueRange(start_, size);
+            } catch (...) {
+                ReleaseRawData();
+                throw;
+            }
+        }
     }
-    Deque(const Deque& deq) noexcept
-            : start_()
+    Deque(const Deque& deq)
+            : Deque(deq, data_traits::select_on_container_copy_construction(
+                                                        deq.data_allocator_)) {}
+    // Only the live range is copied, into a map sized to fit. Elements keep
+    // their offset in the block, so every source block goes into one block
+    // (memcpy for trivially copyable T)
+    Deque(const Deque& deq, const Allocator& alloc)
+            : data_allocator_(alloc)
+            , map_allocator_(data_allocator_)
+            , start_()
             , finish_()
-            , map_(nullptr) {
-        map_ = map_allocator.allocate(deq.map_size_);
-        map_size_ = deq.map_size_;
-
-        map_pointer start_ptr = map_ + (deq.start_.owner_node_ - deq.map_);
-        map_pointer finish_ptr = map_ + (deq.finish_.owner_node_ - deq.map_);
-
-        for (map_pointer this_ptr = start_ptr, other_ptr = deq.start_.owner_node_;
-                        other_ptr <= deq.finish_.owner_node_; ++this_ptr, ++other_ptr) {
-            *this_ptr = AllocateNode();
-            std::copy(*other_ptr, *other_ptr + kInitBuffSize, *this_ptr);
+            , map_(nullptr)
+            , spare_depth_(deq.spare_depth_) {
+        if (deq.start_.owner_node_ == nullptr) {
+            return;
         }
+        int64_t offset = deq.start_.curr_ - deq.start_.first_;
+        CreateMapAndNodes(offset + deq.size());
+        start_.curr_ = start_.first_ + offset;
 
-        start_.SetOwnerNode(start_ptr);
-        start_.curr_ = start_.first_ + (deq.start_.curr_ - deq.start_.first_);
-        finish_.SetOwnerNode(finish_ptr);
-        finish_.curr_ = finish_.first_ + (deq.finish_.curr_ - deq.finish_.first_);
+        iterator done_it = start_;
+        try {
+            deq.for_each_segment([this, &done_it](DequeSpan<const T> segment) {
+                ConstructRange(segment.data(), segment.size(), done_it);
+                done_it += segment.size();
+            });
+        } catch (...) {
+            DestroyRange(start_, done_it);
+            ReleaseRawData();
+            throw;
+        }
     }
     Deque(Deque&& deq) noexcept
-            : start_(std::move(deq.start_))
-            , finish_(std::move(deq.finish_))
-            , map_(deq.map_)
-            , map_size_(deq.map_size_) {
-        deq.map_ = nullptr;
-        deq.map_size_ = 0;
-    }
-    Deque(int64_t size, const T& val) noexcept
-            : start_()
+            : data_allocator_(std::move(deq.data_allocator_))
+            , map_allocator_(data_allocator_)
+            , start_(std::exchange(deq.start_, iterator()))
+            , finish_(std::exchange(deq.finish_, iterator()))
+            , map_(std::exchange(deq.map_, nullptr))
+            , map_size_(std::exchange(deq.map_size_, 0))
+            , reserved_front_(std::exchange(deq.reserved_front_, 0))
+            , reserved_back_(std::exchange(deq.reserved_back_, 0))
+            , reserve_front_limit_(std::exchange(deq.reserve_front_limit_, 0))
+            , reserve_back_limit_(std::exchange(deq.reserve_back_limit_, 0))
+            , spare_nodes_(std::exchange(deq.spare_nodes_, nullptr))
+            , spare_size_(std::exchange(deq.spare_size_, 0))
+            , spare_depth_(deq.spare_depth_)
+            , stats_(std::exchange(deq.stats_, DequeBlockStats{})) {}
+    Deque(int64_t size, const T& val, const Allocator& alloc = Allocator())
+            : data_allocator_(alloc)
+            , map_allocator_(data_allocator_)
+            , start_()
             , finish_()
             , map_(nullptr) {
         CreateMapAndNodes(size);
-        for (map_pointer curr_node = start_.owner_node_; 
-                        curr_node < finish_.owner_node_; ++curr_node) {
-            std::fill(*curr_node, *curr_node + kInitBuffSize, val);
+        try {
+            ConstructRange(RepeatIterator{&val, 0}, size, start_);
+        } catch (...) {
+            ReleaseRawData();
+            throw;
         }
-        std::fill(*(finish_.owner_node_), 
-                *(finish_.owner_node_) + (size % kInitBuffSize), val);
     }
-    Deque(std::initializer_list<T> val_list) noexcept
-            : start_()
+    Deque(std::initializer_list<T> val_list, const Allocator& alloc = Allocator())
+            : data_allocator_(alloc)
+            , map_allocator_(data_allocator_)
+            , start_()
             , finish_()
             , map_(nullptr) {
         CreateMapAndNodes(val_list.size());
-        auto val_list_it = val_list.begin();
-        for (map_pointer curr_node = start_.owner_node_; 
-                        curr_node < finish_.owner_node_; ++curr_node) {
-            std::copy(val_list_it, val_list_it + kInitBuffSize, *curr_node);
-            val_list_it += kInitBuffSize;
+        try {
+            ConstructRange(val_list.begin(), val_list.size(), start_);
+        } catch (...) {
+            ReleaseRawData();
+            throw;
         }
-        std::copy(val_list_it, val_list.end(), *(finish_.owner_node_));
     }
 
     ~Deque() {
-        Clear();
-        map_allocator.deallocate(map_, map_size_);
+        ReleaseData();
     }
 
     Deque& operator=(const Deque& deq) {
-		Deque temp(deq);
-		std::swap(*this, temp);
+        if (this == &deq) {
+            return *this;
+        }
+
+        // temp always owns the allocator *this must end up with
+        Deque temp(deq, data_traits::propagate_on_container_copy_assignment::value
+                                ? deq.data_allocator_ : data_allocator_);
+        SwapData(temp);
+        std::swap(data_allocator_, temp.data_allocator_);
+        std::swap(map_allocator_, temp.map_allocator_);
 
         return *this;
     }
-    Deque& operator=(Deque&& deq) noexcept {
-		Clear();
-        map_allocator.deallocate(map_, map_size_);
+    Deque& operator=(Deque&& deq) noexcept(
+                    data_traits::propagate_on_container_move_assignment::value ||
+                    data_traits::is_always_equal::value) {
+        if (this == &deq) {
+            return *this;
+        }
 
-        start_ = std::move(deq.start_);
-        finish_ = std::move(deq.finish_);
-        map_ = deq.map_;
-        map_size_ = deq.map_size_;        
-        
-		deq.map_ = nullptr;
-        deq.map_size_ = 0;
+        if constexpr (data_traits::propagate_on_container_move_assignment::value) {
+            ReleaseData();
+            data_allocator_ = std::move(deq.data_allocator_);
+            map_allocator_ = map_allocator_type(data_allocator_);
+            StealData(deq);
+        } else if (data_traits::is_always_equal::value ||
+                   data_allocator_ == deq.data_allocator_) {
+            ReleaseData();
+            StealData(deq);
+        } else {
+            // Foreign memory can't be adopted: move elements one by one
+            ReleaseData();
+            for (iterator it = deq.start_; it != deq.finish_; ++it) {
+                push_back(std::move(*it));
+            }
+        }
 
         return *this;
     }
-    Deque& operator=(std::initializer_list<T> val_list) noexcept {
-        CreateMapAndNodes(val_list.size());
-        auto val_list_it = val_list.begin();
-        for (map_pointer curr_node = start_.owner_node_; 
-                        curr_node < finish_.owner_node_; ++curr_node) {
-            std::copy(val_list_it, val_list_it + kInitBuffSize, *curr_node);
-            val_list_it += kInitBuffSize;
-        }
-        std::copy(val_list_it, val_list.end(), *(finish_.owner_node_));
-
+    Deque& operator=(std::initializer_list<T> val_list) {
+        assign(val_list);
         return *this;
     }
 
-    // Actually always shrinked :/
-    void shrink_to_fit() noexcept {}
-
-    int64_t size() const noexcept {
-        return int64_t(finish_ - start_);
+    // Existing elements are assigned over, the rest is constructed or
+    // destroyed at the back, so storage is reused
+    template<typename InputIt, typename = typename std::enable_if<std::is_base_of<
+            std::input_iterator_tag,
+            typename std::iterator_traits<InputIt>::iterator_category>::value>::type>
+    void assign(InputIt first, InputIt last) {
+        iterator it = start_;
+        for (; first != last && it != finish_; ++first, ++it) {
+            *it = *first;
+        }
+        if (first == last) {
+            pop_back(finish_ - it);
+        } else {
+            append_back(first, last);
+        }
     }
-    bool empty() const noexcept {
-        return start_ == finish_;
+    void assign(std::initializer_list<T> val_list) {
+        assign(val_list.begin(), val_list.end());
+    }
+    void assign(int64_t count, const T& val) {
+        T copy(val);
+        int64_t old_size = size();
+        deque_algo::fill(start_, start_ + std::min(count, old_size), copy);
+        if (count <= old_size) {
+            pop_back(old_size - count);
+        } else {
+            AppendN(count - old_size, RepeatIterator{&copy, 0});
+        }
     }
 
-    reference operator[](int64_t ind) noexcept {
-        return start_[difference_type(ind)];
+    // Elements in one block
+    static constexpr int64_t block_size() noexcept {
+        return kInitBuffSize;
     }
-    const T& operator[](int64_t ind) const noexcept {
-        return start_[difference_type(ind)];
+
+    allocator_type get_allocator() const noexcept {
+        return data_allocator_;
     }
-    reference at(int64_t ind) {
-        if (ind < 0 || ind >= size()) {
-            throw std::out_of_range("Deque::at out of range!");
+
+    void swap(Deque& deq) noexcept {
+        if constexpr (data_traits::propagate_on_container_swap::value) {
+            std::swap(data_allocator_, deq.data_allocator_);
+            std::swap(map_allocator_, deq.map_allocator_);
         }
-        return start_[difference_type(ind)];
+        SwapData(deq);
     }
 
-    bool operator==(const Deque& deq) const {
-        if (size() != deq.size()) {
-            return false;
+    // Spare blocks cache: up to depth freed blocks are reused by next growth
+    int64_t block_cache_depth() const noexcept {
+        return spare_depth_;
+    }
+    void set_block_cache_depth(int64_t depth) {
+        if (depth < 0) {
+            throw std::invalid_argument("Deque::set_block_cache_depth error: negative depth!");
         }
-        for (int64_t i = 0; i < size(); ++i) {
-            if ((*this)[i] != deq[i]) {
-                return false;
+        // Live blocks get a cache to come back to (AllocateNode does it for
+        // the next ones)
+        map_pointer new_spare_nodes = nullptr;
+        if (depth > 0 && (spare_nodes_ != nullptr || map_ != nullptr)) {
+            new_spare_nodes = map_traits::allocate(map_allocator_, depth);
+        }
+        ReleaseSpareNodes(depth);
+        if (spare_nodes_ != nullptr) {
+            if (new_spare_nodes != nullptr) {
+                std::copy(spare_nodes_, spare_nodes_ + spare_size_, new_spare_nodes);
             }
+            map_traits::deallocate(map_allocator_, spare_nodes_, spare_depth_);
         }
-        return true;
+        spare_nodes_ = new_spare_nodes;
+        spare_depth_ = depth;
+    }
+    // Returns all cached blocks to the allocator
+    void trim() noexcept {
+        ReleaseSpareNodes(0);
+    }
+    DequeBlockStats block_stats() const noexcept {
+        DequeBlockStats stats = stats_;
+        stats.cached = spare_size_;
+        return stats;
+    }
+
+    // Map is cut down to the live nodes, reserved and spare blocks are released
+    void shrink_to_fit() {
+        ReleaseReservedNodes();
+        DeallocateSpareArray();
+        if (map_ == nullptr) {
+            return;
+        }
+
+        int64_t nodes_size = finish_.owner_node_ - start_.owner_node_ + 1;
+        int64_t new_map_size = std::max(kInitMapSize, nodes_size + 2);
+        if (new_map_size >= map_size_) {
+            return;
+        }
+        map_pointer new_map = map_traits::allocate(map_allocator_, new_map_size);
+        map_pointer start_ptr = new_map + ((new_map_size - nodes_size) >> 1);
+        std::copy(start_.owner_node_, finish_.owner_node_ + 1, start_ptr);
+        map_traits::deallocate(map_allocator_, map_, map_size_);
+        map_ = new_map;
+        map_size_ = new_map_size;
+
+        // Blocks are the same, so curr_ stay valid
+        start_.SetOwnerNode(start_ptr);
+        finish_.SetOwnerNode(start_ptr + nodes_size - 1);
+    }
+
+    // After reserve_front(n) (reserve_back(n)) next n insertions at that end
+    // allocate nothing
+    void reserve_front(int64_t count) {
+        ReserveElemsInFront(count);
+        reserve_front_limit_ = reserved_front_;
+    }
+    void reserve_back(int64_t count) {
+        ReserveElemsInBack(count);
+        reserve_back_limit_ = reserved_back_;
+    }
+    int64_t capacity_front() const noexcept {
+        return (start_.curr_ - start_.first_) + reserved_front_ * kInitBuffSize;
+    }
+    int64_t capacity_back() const noexcept {
+        if (map_ == nullptr) {
+            return 0;
+        }
+        // finish_ must always point into an allocated block
+        return (finish_.last_ - finish_.curr_ - 1) + reserved_back_ * kInitBuffSize;
+    }
+
+    int64_t size() const noexcept {
+        return int64_t(finish_ - start_);
+    }
+    bool empty() const noexcept {
+        return start_ == finish_;
+    }
+
+    // Block and offset are taken straight from the map (no temporary iterator)
+    reference operator[](int64_t ind) noexcept {
+        difference_type offset = difference_type(ind) + (start_.curr_ - start_.first_);
+        return start_.owner_node_[block_math::NodeOffset(offset)]
+                                 [block_math::InNodeOffset(offset)];
+    }
+    const T& operator[](int64_t ind) const noexcept {
+        difference_type offset = difference_type(ind) + (start_.curr_ - start_.first_);
+        return start_.owner_node_[block_math::NodeOffset(offset)]
+                                 [block_math::InNodeOffset(offset)];
+    }
+    reference at(int64_t ind) {
+        if (ind < 0 || ind >= size()) {
+            throw std::out_of_range("Deque::at out of range!");
+        }
+        return (*this)[ind];
+    }
+
+    // Comparisons walk both deques block against block
+    // (memcmp for scalar T without padding bits)
+    bool operator==(const Deque& deq) const {
+        return size() == deq.size() && deque_algo::equal(cbegin(), cend(), deq.cbegin());
+    }
+    bool operator!=(const Deque& deq) const {
+        return !(*this == deq);
     }
+    bool operator<(const Deque& deq) const {
+        return deque_algo::lexicographical_compare(cbegin(), cend(), deq.cbegin(), deq.cend());
+    }
+    bool operator>(const Deque& deq) const {
+        return deq < *this;
+    }
+    bool operator<=(const Deque& deq) const {
+        return !(deq < *this);
+    }
+    bool operator>=(const Deque& deq) const {
+        return !(*this < deq);
+    }
+    #ifdef MY_DEQUE_HAS_THREE_WAY
+    auto operator<=>(const Deque& deq) const requires std::three_way_comparable<T> {
+        return deque_algo::lexicographical_compare_three_way(cbegin(), cend(),
+                                                             deq.cbegin(), deq.cend());
+    }
+    #endif // MY_DEQUE_HAS_THREE_WAY
     #ifdef MY_DEQUE_DEBUG
     bool operator==(const std::deque<T>& deq) const {
         if (static_cast<size_t>(size()) != deq.size()) {
@@ -408,19 +1327,51 @@ class Deque {
         return start_;
     }
     const_iterator begin() const noexcept {
-        return const_iterator(start_.curr_, start_.owner_node_);
+        return start_;
     }
     const_iterator cbegin() const noexcept {
-        return const_iterator(start_.curr_, start_.owner_node_);
+        return start_;
     }
     iterator end() noexcept {
         return finish_;
     }
     const_iterator end() const noexcept {
-        return const_iterator(finish_.curr_, finish_.owner_node_);
+        return finish_;
     }
     const_iterator cend() const noexcept {
-        return const_iterator(finish_.curr_, finish_.owner_node_);
+        return finish_;
+    }
+
+    compact_iterator compact_begin() noexcept {
+        return compact_iterator(start_.owner_node_, start_.curr_ - start_.first_);
+    }
+    const_compact_iterator compact_begin() const noexcept {
+        return compact_iterator(start_.owner_node_, start_.curr_ - start_.first_);
+    }
+    compact_iterator compact_end() noexcept {
+        return compact_iterator(finish_.owner_node_, finish_.curr_ - finish_.first_);
+    }
+    const_compact_iterator compact_end() const noexcept {
+        return compact_iterator(finish_.owner_node_, finish_.curr_ - finish_.first_);
+    }
+
+    // Contiguous blocks from front to back: inner loops over a segment
+    // are plain pointer loops which the compiler can vectorize
+    segment_range segments() noexcept {
+        return segment_range(start_.owner_node_, start_.curr_,
+                             finish_.owner_node_, finish_.curr_);
+    }
+    const_segment_range segments() const noexcept {
+        return const_segment_range(start_.owner_node_, start_.curr_,
+                                   finish_.owner_node_, finish_.curr_);
+    }
+    template<typename Func>
+    void for_each_segment(Func&& func) {
+        ForEachSegment<T>(*this, std::forward<Func>(func));
+    }
+    template<typename Func>
+    void for_each_segment(Func&& func) const {
+        ForEachSegment<const T>(*this, std::forward<Func>(func));
     }
 
     reverse_iterator rbegin() noexcept {
@@ -442,63 +1393,157 @@ class Deque {
         return const_reverse_iterator(cbegin());
     }
 
-    void push_front(const T& val) noexcept {
-        if (start_.curr_ != start_.first_) {
-            data_allocator.construct(--start_.curr_, val);
-        } else {
-            ReserveMapInFront();
-            *(start_.owner_node_ - 1) = AllocateNode();
-            start_.SetOwnerNode(start_.owner_node_ - 1);
-            start_.curr_ = start_.last_ - 1;
-            data_allocator.construct(start_.curr_, val);
-        }
+    void push_front(const T& val) {
+        emplace_front(val);
     }
-    void push_front(T&& val) noexcept {
+    void push_front(T&& val) {
+        emplace_front(std::move(val));
+    }
+    void push_back(const T& val) {
+        emplace_back(val);
+    }
+    void push_back(T&& val) {
+        emplace_back(std::move(val));
+    }
+
+    template<typename... Args>
+    reference emplace_front(Args&&... args) {
         if (start_.curr_ != start_.first_) {
-            data_allocator.construct(--start_.curr_, std::move(val));
+            data_traits::construct(data_allocator_, start_.curr_ - 1,
+                                   std::forward<Args>(args)...);
+            --start_.curr_;
         } else {
-            ReserveMapInFront();
-            *(start_.owner_node_ - 1) = AllocateNode();
+            if (map_ == nullptr) {
+                // First insertion: a block of one element still needs the
+                // step to a new block below
+                CreateEmptyMap(true);
+                if constexpr (kInitBuffSize > 1) {
+                    data_traits::construct(data_allocator_, start_.curr_ - 1,
+                                           std::forward<Args>(args)...);
+                    return *--start_.curr_;
+                }
+            }
+            pointer node = nullptr;
+            if (reserved_front_ == 0) {
+                ReserveMapInFront();
+                node = AllocateNode();
+            }
+            pointer new_first = (node != nullptr) ? node : *(start_.owner_node_ - 1);
+            try {
+                data_traits::construct(data_allocator_, new_first + kInitBuffSize - 1,
+                                       std::forward<Args>(args)...);
+            } catch (...) {
+                if (node != nullptr) {
+                    DeallocateNode(node);
+                }
+                throw;
+            }
+            if (node != nullptr) {
+                *(start_.owner_node_ - 1) = node;
+            } else {
+                --reserved_front_;
+            }
             start_.SetOwnerNode(start_.owner_node_ - 1);
             start_.curr_ = start_.last_ - 1;
-            data_allocator.construct(start_.curr_, std::move(val));
         }
-    }
-    void push_back(const T& val) noexcept {
-        if (finish_.curr_ != finish_.last_ - 1) {
-            data_allocator.construct(finish_.curr_, val);
+        return *start_.curr_;
+    }
+    template<typename... Args>
+    reference emplace_back(Args&&... args) {
+        pointer elem = finish_.curr_;
+        // Also false without map: all pointers are null
+        if (finish_.last_ - finish_.curr_ > 1) {
+            data_traits::construct(data_allocator_, elem, std::forward<Args>(args)...);
             ++finish_.curr_;
         } else {
-            ReserveMapInBack();
-            *(finish_.owner_node_ + 1) = AllocateNode();
-            map_allocator.construct(finish_.curr_, val);
+            if (map_ == nullptr) {
+                CreateEmptyMap(false);
+                elem = finish_.curr_;
+                if constexpr (kInitBuffSize > 1) {
+                    data_traits::construct(data_allocator_, elem, std::forward<Args>(args)...);
+                    ++finish_.curr_;
+                    return *elem;
+                }
+            }
+            pointer node = nullptr;
+            if (reserved_back_ == 0) {
+                ReserveMapInBack();
+                elem = finish_.curr_;
+                node = AllocateNode();
+            }
+            try {
+                data_traits::construct(data_allocator_, elem, std::forward<Args>(args)...);
+            } catch (...) {
+                if (node != nullptr) {
+                    DeallocateNode(node);
+                }
+                throw;
+            }
+            if (node != nullptr) {
+                *(finish_.owner_node_ + 1) = node;
+            } else {
+                --reserved_back_;
+            }
             finish_.SetOwnerNode(finish_.owner_node_ + 1);
             finish_.curr_ = finish_.first_;
         }
+        return *elem;
     }
-    void push_back(T&& val) noexcept {
-        if (finish_.curr_ != finish_.last_ - 1) {
-            data_allocator.construct(finish_.curr_, std::move(val));
-            ++finish_.curr_;
-        } else {
-            ReserveMapInBack();
-            *(finish_.owner_node_ + 1) = AllocateNode();
-            map_allocator.construct(finish_.curr_, std::move(val));
-            finish_.SetOwnerNode(finish_.owner_node_ + 1);
-            finish_.curr_ = finish_.first_;
+    // Ends are constructed in place, middle goes through a temporary
+    // which is moved into the opened slot
+    template<typename... Args>
+    iterator emplace(const_iterator c_pos, Args&&... args) {
+        iterator pos = MakeIterator(c_pos);
+        if (pos == start_) {
+            emplace_front(std::forward<Args>(args)...);
+            return start_;
         }
+        if (pos == finish_) {
+            emplace_back(std::forward<Args>(args)...);
+            return finish_ - 1;
+        }
+
+        T temp(std::forward<Args>(args)...);
+        return insert(pos, std::move(temp));
+    }
+
+    // Bulk insertion: map and blocks are reserved once, then filled block
+    // by block (memcpy when T is trivially copyable and source is contiguous)
+    template<typename InputIt>
+    void append_back(InputIt first, InputIt last) {
+        AppendBack(first, last,
+                   typename std::iterator_traits<InputIt>::iterator_category());
+    }
+    void append_back(std::initializer_list<T> val_list) {
+        append_back(val_list.begin(), val_list.end());
+    }
+    template<typename InputIt>
+    void append_front(InputIt first, InputIt last) {
+        AppendFront(first, last,
+                    typename std::iterator_traits<InputIt>::iterator_category());
+    }
+    void append_front(std::initializer_list<T> val_list) {
+        append_front(val_list.begin(), val_list.end());
     }
+    #ifdef MY_DEQUE_HAS_SPAN
+    void append_back(std::span<const T> vals) {
+        append_back(vals.data(), vals.data() + vals.size());
+    }
+    void append_front(std::span<const T> vals) {
+        append_front(vals.data(), vals.data() + vals.size());
+    }
+    #endif // MY_DEQUE_HAS_SPAN
 
     void pop_front() {
         if (empty()) {
             throw std::runtime_error("Deque::pop_front error: deque is empty!");
         }
         if (start_.curr_ != start_.last_ - 1) {
-            data_allocator.destroy(start_.curr_);
+            data_traits::destroy(data_allocator_, start_.curr_);
             ++start_.curr_;
         } else {
-            data_allocator.destroy(start_.curr_);
-            DeallocateNode(start_.first_);
+            data_traits::destroy(data_allocator_, start_.curr_);
+            DropFrontNodes(start_.owner_node_, start_.owner_node_ + 1);
             start_.SetOwnerNode(start_.owner_node_ + 1);
             start_.curr_ = start_.first_;
         }
@@ -508,143 +1553,126 @@ class Deque {
             throw std::runtime_error("Deque::pop_back error: deque is empty!");
         }
         if (finish_.curr_ != finish_.first_) {
-            data_allocator.destroy(finish_.curr_);
             --finish_.curr_;
+            data_traits::destroy(data_allocator_, finish_.curr_);
         } else {
-            DeallocateNode(finish_.first_);
+            DropBackNodes(finish_.owner_node_, finish_.owner_node_ + 1);
             finish_.SetOwnerNode(finish_.owner_node_ - 1);
             finish_.curr_ = finish_.last_ - 1;
-            data_allocator.destroy(finish_.curr_);
+            data_traits::destroy(data_allocator_, finish_.curr_);
         }
     }
 
-    void insert(iterator pos, const T& val) noexcept {
-        if (pos == start_) {
-            push_front(val);
-            return;
+    // Bulk removal: destructors run block by block (skipped for trivially
+    // destructible T), drained blocks are freed in one pass
+    void pop_front(int64_t count) {
+        if (count < 0 || count > size()) {
+            throw std::out_of_range("Deque::pop_front error: deque is too short!");
         }
-        if (pos == finish_) {
-            push_back(val);
-            return;
+        iterator new_start = start_ + count;
+        DestroyRange(start_, new_start);
+        DropFrontNodes(start_.owner_node_, new_start.owner_node_);
+        start_ = new_start;
+    }
+    void pop_back(int64_t count) {
+        if (count < 0 || count > size()) {
+            throw std::out_of_range("Deque::pop_back error: deque is too short!");
         }
-
-        difference_type ind = pos - start_;
-        if (ind < (size() >> 1)) {
-            // First half
-            push_front(front());
-            iterator front_1 = start_;
-            ++front_1;
-            iterator front_2 = front_1;
-            ++front_2;
-
-            pos = start_ + ind;
-            iterator pos_1 = pos;
-            ++pos_1;
-            std::copy(front_2, pos_1, front_1);
-        } else {
-            // Second half
-            push_back(back());
-            iterator back_1 = finish_;
-            --back_1;
-            iterator back_2 = back_1;
-            --back_2;
-
-            pos = start_ + ind;
-            std::copy_backward(pos, back_2, back_1);
+        iterator new_finish = finish_ - count;
+        DestroyRange(new_finish, finish_);
+        DropBackNodes(new_finish.owner_node_ + 1, finish_.owner_node_ + 1);
+        finish_ = new_finish;
+    }
+    // Moves count front elements to out and pops them
+    template<typename OutputIt>
+    OutputIt consume_front(int64_t count, OutputIt out) {
+        if (count < 0 || count > size()) {
+            throw std::out_of_range("Deque::consume_front error: deque is too short!");
         }
-
-        *pos = val;
+        iterator it = start_;
+        for (int64_t left = count; left > 0; ) {
+            int64_t chunk = std::min<int64_t>(left, it.last_ - it.curr_);
+            out = std::move(it.curr_, it.curr_ + chunk, out);
+            it += chunk;
+            left -= chunk;
+        }
+        pop_front(count);
+        return out;
     }
-    void insert(iterator pos, T&& val) noexcept {
-        if (pos == start_) {
-            push_front(std::move(val));
+
+    // Grows with value-initialized elements (copies of val) or pops the tail
+    void resize(int64_t count) {
+        if (count <= size()) {
+            pop_back(size() - count);
             return;
         }
-        if (pos == finish_) {
-            push_back(std::move(val));
+        int64_t add_size = count - size();
+        ReserveElemsInBack(add_size);
+        iterator new_finish = finish_ + add_size;
+        ConstructValueRange(finish_, add_size);
+        reserved_back_ -= new_finish.owner_node_ - finish_.owner_node_;
+        finish_ = new_finish;
+    }
+    void resize(int64_t count, const T& val) {
+        if (count <= size()) {
+            pop_back(size() - count);
             return;
         }
-
-        difference_type ind = pos - start_;
-        if (ind < (size() >> 1)) {
-            // First half
-            push_front(front());
-            iterator front_1 = start_;
-            ++front_1;
-            iterator front_2 = front_1;
-            ++front_2;
-
-            pos = start_ + ind;
-            iterator pos_1 = pos;
-            ++pos_1;
-            std::copy(front_2, pos_1, front_1);
-        } else {
-            // Second half
-            push_back(back());
-            iterator back_1 = finish_;
-            --back_1;
-            iterator back_2 = back_1;
-            --back_2;
-
-            pos = start_ + ind;
-            std::copy_backward(pos, back_2, back_1);
-        }
-        
-        *pos = std::move(val);
+        T copy(val);
+        AppendN(count - size(), RepeatIterator{&copy, 0});
     }
-    void insert(iterator pos, std::initializer_list<T> val_list) noexcept {
-        difference_type val_list_size = difference_type(val_list.size());
-        if (pos == start_) {
-            for (size_t i = 0; i < val_list.size(); ++i) {
-                push_front(0);
-            }
-            std::copy(val_list.begin(), val_list.end(), start_);
-            return;
-        }
-        if (pos == finish_) {
-            for (size_t i = 0; i < val_list.size(); ++i) {
-                push_back(0);
-            }
-            std::copy(val_list.begin(), val_list.end(), finish_ - (val_list_size - 1));
+    // Destroys all elements but keeps one block with start_ & finish_ in
+    // its middle, so a reused deque allocates nothing for small contents
+    void clear() noexcept {
+        if (start_.owner_node_ == nullptr) {
             return;
         }
+        DestroyRange(start_, finish_);
+        DropBackNodes(start_.owner_node_ + 1, finish_.owner_node_ + 1);
+        start_.curr_ = start_.first_ + (kInitBuffSize >> 1);
+        finish_ = start_;
+    }
 
-        difference_type mid_ind = pos + (val_list_size >> 1) - start_;
-        difference_type ind = pos - start_;
-        if (mid_ind < (size() >> 1)) {
-            for (size_t i = 0; i < val_list.size(); ++i) {
-                push_front(*(start_ + (val_list_size - 1)));
-            }
-
-            iterator front_len = start_ + val_list_size;
-            iterator front_len_2 = front_len + val_list_size;
-            pos = start_ + ind;
-            iterator pos_len = pos + val_list_size;
-            std::copy(front_len_2, pos_len, front_len);
-        } else {
-            for (size_t i = 0; i < val_list.size(); ++i) {
-                push_back(*(finish_ - val_list_size));
-            }
-
-            iterator back_len = finish_ - val_list_size;
-            iterator back_len_2 = back_len - val_list_size;
-            pos = start_ + ind;
-            std::copy_backward(pos, back_len_2, back_len);
-        }
-
-        std::copy(val_list.begin(), val_list.end(), pos);
+    iterator insert(iterator pos, const T& val) {
+        // val may live in this deque and be shifted, so copy it first
+        T copy(val);
+        return insert(pos, std::move(copy));
+    }
+    iterator insert(iterator pos, T&& val) {
+        return InsertN(pos - start_, 1, std::make_move_iterator(&val));
+    }
+    iterator insert(iterator pos, std::initializer_list<T> val_list) {
+        return InsertN(pos - start_, difference_type(val_list.size()), val_list.begin());
+    }
+    // Range and fill insertion open the whole gap at once
+    template<typename InputIt, typename = typename std::enable_if<std::is_base_of<
+            std::input_iterator_tag,
+            typename std::iterator_traits<InputIt>::iterator_category>::value>::type>
+    iterator insert(iterator pos, InputIt first, InputIt last) {
+        return InsertRange(pos - start_, first, last,
+                           typename std::iterator_traits<InputIt>::iterator_category());
     }
-    void insert(const_iterator c_pos, const T& val) noexcept {
-        iterator pos = c_pos;
-        insert(pos, val);
+    iterator insert(iterator pos, int64_t count, const T& val) {
+        T copy(val);
+        return InsertN(pos - start_, count, RepeatIterator{&copy, 0});
     }
-    void insert(const_iterator c_pos, T&& val) noexcept {
-        iterator pos = c_pos;
-        insert(pos, std::move(val));
+    iterator insert(const_iterator c_pos, const T& val) {
+        return insert(MakeIterator(c_pos), val);
     }
-    void insert(const_iterator c_pos, std::initializer_list<T> val_list) noexcept {
-        iterator pos = c_pos;
-        insert(pos, val_list);
+    iterator insert(const_iterator c_pos, T&& val) {
+        return insert(MakeIterator(c_pos), std::move(val));
+    }
+    iterator insert(const_iterator c_pos, std::initializer_list<T> val_list) {
+        return insert(MakeIterator(c_pos), val_list);
+    }
+    template<typename InputIt, typename = typename std::enable_if<std::is_base_of<
+            std::input_iterator_tag,
+            typename std::iterator_traits<InputIt>::iterator_category>::value>::type>
+    iterator insert(const_iterator c_pos, InputIt first, InputIt last) {
+        return insert(MakeIterator(c_pos), first, last);
+    }
+    iterator insert(const_iterator c_pos, int64_t count, const T& val) {
+        return insert(MakeIterator(c_pos), count, val);
     }
 
     void erase(iterator pos) {
@@ -653,65 +1681,163 @@ class Deque {
         difference_type ind = pos - start_;
         if (ind < difference_type(size() >> 1)) {
             // First half
-            std::copy_backward(start_, pos, next);
+            deque_algo::move_backward(start_, pos, next);
             pop_front();
         } else {
             // Second half
-            std::copy(next, finish_, pos);
+            deque_algo::move(next, finish_, pos);
             pop_back();
         }
     }
     void erase(const_iterator c_pos) {
-        iterator pos = c_pos;
-        erase(pos);
+        erase(MakeIterator(c_pos));
     }
 
     void erase(iterator from, iterator to) {
+        // Empty range: shifting would move elements onto themselves
+        if (from == to) {
+            return;
+        }
         if (from == start_ && to == finish_) {
-            Clear();
+            clear();
             return;
         }
         difference_type erase_size = to - from;
         difference_type elems_before = from - start_;
         if (elems_before < difference_type((size() - erase_size) >> 1)) {
-            std::copy_backward(start_, from, to);
-            iterator new_start = start_ + erase_size;
-            for (map_pointer curr_node = start_.owner_node_; 
-                            curr_node < new_start.owner_node_; ++curr_node) {
-                for (int64_t i = 0; i <= kInitBuffSize; ++i) {
-                    data_allocator.destroy(*curr_node + i);
-                }
-                data_allocator.deallocate(*curr_node, kInitBuffSize);
-            }
-            start_ = new_start;
+            deque_algo::move_backward(start_, from, to);
+            pop_front(erase_size);
         } else {
-            std::copy(to, finish_, from);
-            iterator new_finish = finish_ - erase_size;
-            for (map_pointer curr_node = new_finish.owner_node_ + 1;
-                            curr_node <= finish_.owner_node_; ++curr_node) {
-                for (int64_t i = 0; i <= kInitBuffSize; ++i) {
-                    data_allocator.destroy(*curr_node + i);
-                }
-                data_allocator.deallocate(*curr_node, kInitBuffSize);
-            }
-            finish_ = new_finish;
+            deque_algo::move(to, finish_, from);
+            pop_back(erase_size);
         }
     }
 
   private:
+    // count copies of *val_ as a forward range, for insert(pos, count, val)
+    struct RepeatIterator {
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef int64_t difference_type;
+        typedef const T* pointer;
+        typedef const T& reference;
+
+        const T* val_;
+        int64_t index_;
+
+        const T& operator*() const noexcept {
+            return *val_;
+        }
+        RepeatIterator& operator++() noexcept {
+            ++index_;
+            return *this;
+        }
+        RepeatIterator operator++(int) noexcept {
+            RepeatIterator res = *this;
+            ++index_;
+            return res;
+        }
+        bool operator==(const RepeatIterator& other) const noexcept {
+            return index_ == other.index_;
+        }
+        bool operator!=(const RepeatIterator& other) const noexcept {
+            return index_ != other.index_;
+        }
+    };
+
+    allocator_type data_allocator_;
+    map_allocator_type map_allocator_;
+
     iterator start_;
     iterator finish_;
     map_pointer map_{nullptr};
     int64_t map_size_{0};
+    // Allocated blocks right before start_ and after finish_ nodes
+    int64_t reserved_front_{0};
+    int64_t reserved_back_{0};
+    // Reserved blocks left by the last reserve_front (reserve_back) call:
+    // blocks drained at that end refill the reserve up to this size only
+    int64_t reserve_front_limit_{0};
+    int64_t reserve_back_limit_{0};
+
+    // Freed blocks are kept here (up to spare_depth_) for the next AllocateNode
+    map_pointer spare_nodes_{nullptr};
+    int64_t spare_size_{0};
+    int64_t spare_depth_{kInitSpareDepth};
+    DequeBlockStats stats_{};
 
     static constexpr int64_t kInitMapSize = 16;
-    static constexpr int64_t kInitBuffSize = sizeof(T) < 256 ? 4096 / sizeof(T) : 16;
+    static constexpr int64_t kInitSpareDepth = 2;
+
+    template<typename SegmentT, typename Self, typename Func>
+    static void ForEachSegment(Self& deq, Func&& func) {
+        if (deq.start_.owner_node_ == deq.finish_.owner_node_) {
+            if (deq.start_.curr_ != deq.finish_.curr_) {
+                func(DequeSpan<SegmentT>(deq.start_.curr_,
+                                         deq.finish_.curr_ - deq.start_.curr_));
+            }
+            return;
+        }
+        func(DequeSpan<SegmentT>(deq.start_.curr_, deq.start_.last_ - deq.start_.curr_));
+        for (map_pointer curr_node = deq.start_.owner_node_ + 1;
+                        curr_node < deq.finish_.owner_node_; ++curr_node) {
+            func(DequeSpan<SegmentT>(*curr_node, kInitBuffSize));
+        }
+        if (deq.finish_.curr_ != deq.finish_.first_) {
+            func(DequeSpan<SegmentT>(deq.finish_.first_,
+                                     deq.finish_.curr_ - deq.finish_.first_));
+        }
+    }
+
+    static iterator MakeIterator(const_iterator c_it) noexcept {
+        iterator it;
+        it.curr_ = const_cast<pointer>(c_it.curr_);
+        it.first_ = const_cast<pointer>(c_it.first_);
+        it.last_ = const_cast<pointer>(c_it.last_);
+        it.owner_node_ = const_cast<map_pointer>(c_it.owner_node_);
+        return it;
+    }
 
     pointer AllocateNode() {
-        return data_allocator.allocate(kInitBuffSize);
+        if (spare_size_ > 0) {
+            ++stats_.reused;
+            return spare_nodes_[--spare_size_];
+        }
+        // Cache comes with the first block, so releasing never allocates
+        if (spare_nodes_ == nullptr && spare_depth_ > 0) {
+            spare_nodes_ = map_traits::allocate(map_allocator_, spare_depth_);
+        }
+        ++stats_.allocated;
+        return data_traits::allocate(data_allocator_, kInitBuffSize);
+    }
+    void DeallocateNode(pointer node) noexcept {
+        if (spare_size_ < spare_depth_ && spare_nodes_ != nullptr) {
+            spare_nodes_[spare_size_++] = node;
+            return;
+        }
+        ++stats_.released;
+        data_traits::deallocate(data_allocator_, node, kInitBuffSize);
+    }
+    // Teardown: blocks go straight to the allocator, not through the cache
+    void ReleaseNodes(map_pointer first_node, map_pointer last_node) noexcept {
+        for (map_pointer curr_node = first_node; curr_node < last_node; ++curr_node) {
+            ++stats_.released;
+            data_traits::deallocate(data_allocator_, *curr_node, kInitBuffSize);
+        }
+    }
+    void ReleaseSpareNodes(int64_t keep_size) noexcept {
+        while (spare_size_ > keep_size) {
+            ++stats_.released;
+            data_traits::deallocate(data_allocator_, spare_nodes_[--spare_size_],
+                                    kInitBuffSize);
+        }
     }
-    void DeallocateNode(pointer node) {
-        data_allocator.deallocate(node, kInitBuffSize);
+    void DeallocateSpareArray() noexcept {
+        ReleaseSpareNodes(0);
+        if (spare_nodes_ != nullptr) {
+            map_traits::deallocate(map_allocator_, spare_nodes_, spare_depth_);
+            spare_nodes_ = nullptr;
+        }
     }
     void CreateMapAndNodes(int64_t elems_size) {
         int64_t nodes_size = elems_size / kInitBuffSize + 1;
@@ -719,88 +1845,1322 @@ class Deque {
         // (+ 2) Begin and last will be allocate more memory
         // to save time for inserting elements in deque.
         map_size_ = std::max(kInitMapSize, nodes_size + 2);
-        map_ = map_allocator.allocate(map_size_);
+        map_ = map_traits::allocate(map_allocator_, map_size_);
 
         // Aligning start_ & finish_
         map_pointer start_ptr = map_ + ((map_size_ - nodes_size) >> 1);
         map_pointer finish_ptr = start_ptr + nodes_size - 1;
         for (map_pointer curr_ptr = start_ptr; curr_ptr <= finish_ptr; ++curr_ptr) {
             *curr_ptr = AllocateNode();
-            std::memset(*curr_ptr, 0, sizeof(T) * kInitBuffSize);
         }
         start_.SetOwnerNode(start_ptr);
         finish_.SetOwnerNode(finish_ptr);
         start_.curr_ = start_.first_;
         finish_.curr_ = finish_.first_ + (elems_size % kInitBuffSize);
     }
+    // First insertion after lazy construction: one block, start_ & finish_
+    // at the edge the deque grows from (finish_ stays inside the block)
+    void CreateEmptyMap(bool is_in_front) {
+        CreateMapAndNodes(0);
+        if (is_in_front) {
+            start_.curr_ = start_.last_ - 1;
+            finish_ = start_;
+        }
+    }
     void ReallocateMap(int64_t add_nodes_size, bool is_in_front) {
-        int64_t old_nodes_size = finish_.owner_node_ - start_.owner_node_ + 1;
+        // Reserved blocks around start_ & finish_ move together with them
+        map_pointer first_node = start_.owner_node_ - reserved_front_;
+        map_pointer last_node = finish_.owner_node_ + reserved_back_;
+        int64_t live_nodes_size = finish_.owner_node_ - start_.owner_node_ + 1;
+        int64_t old_nodes_size = last_node - first_node + 1;
         int64_t new_nodes_size = old_nodes_size + add_nodes_size;
         map_pointer start_ptr;
         if (map_size_ >= new_nodes_size + 2) {
             // Balancing map_size_
             start_ptr = map_ + ((map_size_ - new_nodes_size) >> 1) +
                         ((is_in_front)? add_nodes_size : 0);
-            if (start_ptr < start_.owner_node_) {
-                std::copy(start_.owner_node_, finish_.owner_node_ + 1, start_ptr);
+            if (start_ptr < first_node) {
+                std::copy(first_node, last_node + 1, start_ptr);
             } else {
-                std::copy_backward(start_.owner_node_, finish_.owner_node_ + 1, start_ptr + old_nodes_size);
+                std::copy_backward(first_node, last_node + 1, start_ptr + old_nodes_size);
             }
         } else {
             int64_t new_map_size = map_size_ + std::max(map_size_, add_nodes_size) + 2;
             // New memory allocation
-            map_pointer new_map = map_allocator.allocate(new_map_size);
+            map_pointer new_map = map_traits::allocate(map_allocator_, new_map_size);
             start_ptr = new_map + ((new_map_size - new_nodes_size) >> 1) +
                         ((is_in_front)? add_nodes_size : 0);
-            std::copy(start_.owner_node_, finish_.owner_node_ + 1, start_ptr);
-            map_allocator.deallocate(map_, map_size_);
+            std::copy(first_node, last_node + 1, start_ptr);
+            map_traits::deallocate(map_allocator_, map_, map_size_);
             map_ = new_map;
             map_size_ = new_map_size;
         }
 
         // Reset start_ & finish_
-        start_.SetOwnerNode(start_ptr);
-        finish_.SetOwnerNode(start_ptr + old_nodes_size - 1);
+        start_.SetOwnerNode(start_ptr + reserved_front_);
+        finish_.SetOwnerNode(start_ptr + reserved_front_ + live_nodes_size - 1);
+    }
+    // Allocates reserved blocks so that elems_size more elements fit before
+    // start_ (or after finish_), start_ & finish_ stay where they are
+    void ReserveElemsInFront(int64_t elems_size) {
+        if (elems_size > 0 && map_ == nullptr) {
+            CreateEmptyMap(true);
+        }
+        int64_t vacancies = capacity_front();
+        if (elems_size <= vacancies) {
+            return;
+        }
+        int64_t add_nodes_size = (elems_size - vacancies + kInitBuffSize - 1) / kInitBuffSize;
+        ReserveMapInFront(add_nodes_size);
+        for (int64_t i = 0; i < add_nodes_size; ++i) {
+            *(start_.owner_node_ - reserved_front_ - 1) = AllocateNode();
+            ++reserved_front_;
+        }
     }
-    void ReserveMapInFront(int64_t add_nodes_size = 1) {
-        if (add_nodes_size > start_.owner_node_ - map_) {
-            ReallocateMap(add_nodes_size, true);
+    void ReserveElemsInBack(int64_t elems_size) {
+        if (elems_size > 0 && map_ == nullptr) {
+            CreateEmptyMap(false);
+        }
+        int64_t vacancies = capacity_back();
+        if (elems_size <= vacancies) {
+            return;
+        }
+        int64_t add_nodes_size = (elems_size - vacancies + kInitBuffSize - 1) / kInitBuffSize;
+        ReserveMapInBack(add_nodes_size);
+        for (int64_t i = 0; i < add_nodes_size; ++i) {
+            *(finish_.owner_node_ + reserved_back_ + 1) = AllocateNode();
+            ++reserved_back_;
         }
     }
-    void ReserveMapInBack(int64_t add_nodes_size = 1) {
-        if (add_nodes_size > map_size_ - (finish_.owner_node_ - map_) - 1) {
-            ReallocateMap(add_nodes_size, false);
+    void FreeNodes(map_pointer first_node, map_pointer last_node) noexcept {
+        for (map_pointer curr_node = first_node; curr_node < last_node; ++curr_node) {
+            DeallocateNode(*curr_node);
+        }
+    }
+    // Blocks left by start_ (finish_) stay reserved if there are reserved
+    // blocks behind them, up to the reserve limit. Reserved blocks must be
+    // adjacent to the live ones, so the farthest ones are freed
+    void DropFrontNodes(map_pointer first_node, map_pointer last_node) noexcept {
+        int64_t kept_size = 0;
+        if (reserved_front_ > 0) {
+            kept_size = std::min(reserved_front_ + (last_node - first_node),
+                                 std::max(reserved_front_, reserve_front_limit_));
+        }
+        FreeNodes(first_node - reserved_front_, last_node - kept_size);
+        reserved_front_ = kept_size;
+    }
+    void DropBackNodes(map_pointer first_node, map_pointer last_node) noexcept {
+        int64_t kept_size = 0;
+        if (reserved_back_ > 0) {
+            kept_size = std::min(reserved_back_ + (last_node - first_node),
+                                 std::max(reserved_back_, reserve_back_limit_));
+        }
+        FreeNodes(first_node + kept_size, last_node + reserved_back_);
+        reserved_back_ = kept_size;
+    }
+    void ReleaseReservedNodes() noexcept {
+        if (start_.owner_node_ == nullptr) {
+            return;
         }
+        FreeNodes(start_.owner_node_ - reserved_front_, start_.owner_node_);
+        FreeNodes(finish_.owner_node_ + 1, finish_.owner_node_ + reserved_back_ + 1);
+        reserved_front_ = 0;
+        reserved_back_ = 0;
+        reserve_front_limit_ = 0;
+        reserve_back_limit_ = 0;
     }
 
-    // Only one buffer will be left
-    void Clear() {
-        for (map_pointer curr_node = start_.owner_node_ + 1; 
-                        curr_node < finish_.owner_node_; ++curr_node) {
-            for (int64_t i = 0; i < kInitBuffSize; ++i) {
-                data_allocator.destroy(*curr_node + i);
+    // Constructs [first, first + count) into raw memory at dest
+    template<typename InputIt>
+    InputIt ConstructBlock(InputIt first, int64_t count, pointer dest) {
+        typedef typename std::remove_cv<typename std::remove_pointer<InputIt>::type>::type
+                            source_type;
+        if constexpr (kBitwiseCopy && std::is_pointer<InputIt>::value &&
+                      std::is_same<source_type, T>::value) {
+            std::memcpy(static_cast<void*>(dest), first, count * sizeof(T));
+            return first + count;
+        } else {
+            int64_t done = 0;
+            try {
+                for (; done < count; ++done, ++first) {
+                    data_traits::construct(data_allocator_, dest + done, *first);
+                }
+            } catch (...) {
+                DestroyBlock(dest, dest + done);
+                throw;
+            }
+            return first;
+        }
+    }
+    void DestroyBlock(pointer first, pointer last) noexcept {
+        if constexpr (!std::is_trivially_destructible<T>::value) {
+            for (; first != last; ++first) {
+                data_traits::destroy(data_allocator_, first);
             }
-            data_allocator.deallocate(*curr_node, kInitBuffSize);
         }
+    }
+    void DestroyRange(iterator first, iterator last) noexcept {
+        if constexpr (!std::is_trivially_destructible<T>::value) {
+            while (first != last) {
+                pointer block_last = (first.owner_node_ == last.owner_node_)
+                                                ? last.curr_ : first.last_;
+                DestroyBlock(first.curr_, block_last);
+                first += block_last - first.curr_;
+            }
+        }
+    }
+    // Fills raw [dest, dest + elems_size) block by block
+    template<typename InputIt>
+    void ConstructRange(InputIt first, int64_t elems_size, iterator dest) {
+        iterator done_it = dest;
+        try {
+            while (elems_size > 0) {
+                int64_t chunk = std::min<int64_t>(elems_size, done_it.last_ - done_it.curr_);
+                first = ConstructBlock(first, chunk, done_it.curr_);
+                done_it += chunk;
+                elems_size -= chunk;
+            }
+        } catch (...) {
+            DestroyRange(dest, done_it);
+            throw;
+        }
+    }
+
+    // Value-initializes raw [dest, dest + elems_size) block by block
+    // (memset for trivial T)
+    void ConstructValueRange(iterator dest, int64_t elems_size) {
+        iterator done_it = dest;
+        try {
+            while (elems_size > 0) {
+                int64_t chunk = std::min<int64_t>(elems_size, done_it.last_ - done_it.curr_);
+                if constexpr (kBitwiseCopy && !std::is_member_pointer<T>::value &&
+                              std::is_trivially_default_constructible<T>::value) {
+                    std::memset(static_cast<void*>(done_it.curr_), 0, chunk * sizeof(T));
+                } else {
+                    int64_t done = 0;
+                    try {
+                        for (; done < chunk; ++done) {
+                            data_traits::construct(data_allocator_, done_it.curr_ + done);
+                        }
+                    } catch (...) {
+                        DestroyBlock(done_it.curr_, done_it.curr_ + done);
+                        throw;
+                    }
+                }
+                done_it += chunk;
+                elems_size -= chunk;
+            }
+        } catch (...) {
+            DestroyRange(dest, done_it);
+            throw;
+        }
+    }
+
+    template<typename InputIt>
+    void AppendBack(InputIt first, InputIt last, std::input_iterator_tag) {
+        for (; first != last; ++first) {
+            emplace_back(*first);
+        }
+    }
+    template<typename ForwardIt>
+    void AppendBack(ForwardIt first, ForwardIt last, std::forward_iterator_tag) {
+        AppendN(std::distance(first, last), first);
+    }
+    template<typename InputIt>
+    void AppendN(int64_t elems_size, InputIt first) {
+        ReserveElemsInBack(elems_size);
+        iterator new_finish = finish_ + elems_size;
+        // On failure blocks just stay reserved
+        ConstructRange(first, elems_size, finish_);
+        reserved_back_ -= new_finish.owner_node_ - finish_.owner_node_;
+        finish_ = new_finish;
+    }
+    template<typename InputIt>
+    void AppendFront(InputIt first, InputIt last, std::input_iterator_tag) {
+        // Length is unknown: collect elements first
+        Deque temp(data_allocator_);
+        temp.AppendBack(first, last, std::input_iterator_tag());
+        AppendFront(std::make_move_iterator(temp.begin()),
+                    std::make_move_iterator(temp.end()), std::forward_iterator_tag());
+    }
+    template<typename ForwardIt>
+    void AppendFront(ForwardIt first, ForwardIt last, std::forward_iterator_tag) {
+        int64_t elems_size = std::distance(first, last);
+        ReserveElemsInFront(elems_size);
+        iterator new_start = start_ - elems_size;
+        ConstructRange(first, elems_size, new_start);
+        reserved_front_ -= start_.owner_node_ - new_start.owner_node_;
+        start_ = new_start;
+    }
 
-        if (start_.owner_node_ != finish_.owner_node_) {
-            for (pointer pt = start_.curr_; pt != start_.last_; ++pt) {
-                data_allocator.destroy(pt);
+    // Inserts [first, first + n) before index ind in one structural step:
+    // blocks are reserved once on the shorter side, slots beyond the old end
+    // are constructed in place (from the shifted elements or, where the gap
+    // reaches them, from the new values), the rest is shifted with moves
+    template<typename ForwardIt>
+    iterator InsertN(difference_type ind, difference_type n, ForwardIt first) {
+        if (n <= 0) {
+            return start_ + ind;
+        }
+        difference_type old_size = size();
+        if (ind < old_size - ind) {
+            // New raw slots [0, n): elements [0, moved), then values
+            difference_type moved = std::min(n, ind);
+            ReserveElemsInFront(n);
+            iterator new_start = start_ - n;
+            ForwardIt mid = first;
+            std::advance(mid, n - moved);
+            ConstructRange(std::make_move_iterator(start_), moved, new_start);
+            try {
+                ConstructRange(first, n - moved, new_start + moved);
+            } catch (...) {
+                DestroyRange(new_start, new_start + moved);
+                throw;
             }
-            for (pointer pt = finish_.first_; pt != finish_.curr_; ++pt) {
-                data_allocator.destroy(pt);
+            reserved_front_ -= start_.owner_node_ - new_start.owner_node_;
+            start_ = new_start;
+
+            if (ind > n) {
+                deque_algo::move(start_ + 2 * n, start_ + (n + ind), start_ + n);
             }
-            data_allocator.deallocate(finish_.first_, kInitBuffSize);
+            std::copy_n(mid, moved, start_ + std::max(ind, n));
         } else {
-            for (pointer pt = start_.curr_; pt != finish_.curr_; ++pt) {
-                data_allocator.destroy(pt);
+            // New raw slots [old_size, old_size + n): values, then elements
+            difference_type moved = std::min(n, old_size - ind);
+            ReserveElemsInBack(n);
+            iterator old_finish = finish_;
+            ForwardIt mid = first;
+            std::advance(mid, moved);
+            ConstructRange(mid, n - moved, old_finish);
+            try {
+                ConstructRange(std::make_move_iterator(start_ + (old_size - moved)), moved,
+                               old_finish + (n - moved));
+            } catch (...) {
+                DestroyRange(old_finish, old_finish + (n - moved));
+                throw;
+            }
+            iterator new_finish = old_finish + n;
+            reserved_back_ -= new_finish.owner_node_ - finish_.owner_node_;
+            finish_ = new_finish;
+
+            if (old_size - ind > n) {
+                deque_algo::move_backward(start_ + ind, start_ + (old_size - n),
+                                          start_ + old_size);
             }
+            std::copy_n(first, moved, start_ + ind);
+        }
+        return start_ + ind;
+    }
+    template<typename InputIt>
+    iterator InsertRange(difference_type ind, InputIt first, InputIt last,
+                         std::input_iterator_tag) {
+        // Length is unknown: collect elements first
+        Deque temp(data_allocator_);
+        temp.AppendBack(first, last, std::input_iterator_tag());
+        return InsertN(ind, temp.size(), std::make_move_iterator(temp.begin()));
+    }
+    template<typename ForwardIt>
+    iterator InsertRange(difference_type ind, ForwardIt first, ForwardIt last,
+                         std::forward_iterator_tag) {
+        return InsertN(ind, std::distance(first, last), first);
+    }
+
+    void ReserveMapInFront(int64_t add_nodes_size = 1) {
+        if (add_nodes_size > start_.owner_node_ - reserved_front_ - map_) {
+            ReallocateMap(add_nodes_size, true);
+        }
+    }
+    void ReserveMapInBack(int64_t add_nodes_size = 1) {
+        if (add_nodes_size > map_size_ - (finish_.owner_node_ + reserved_back_ - map_) - 1) {
+            ReallocateMap(add_nodes_size, false);
         }
+    }
 
-        data_allocator.deallocate(start_.first_, kInitBuffSize);
+    // All blocks are freed, iterators are reset
+    void Clear() {
+        if (start_.owner_node_ == nullptr) {
+            return;
+        }
+        DestroyRange(start_, finish_);
+        // Reserved blocks are adjacent to the live ones
+        ReleaseNodes(start_.owner_node_ - reserved_front_,
+                     finish_.owner_node_ + reserved_back_ + 1);
+        reserved_front_ = 0;
+        reserved_back_ = 0;
+        reserve_front_limit_ = 0;
+        reserve_back_limit_ = 0;
+        start_.Clear();
+        finish_.Clear();
+    }
+    // Elements were never constructed (constructor failed):
+    // only blocks and map are freed
+    void ReleaseRawData() noexcept {
+        ReleaseNodes(start_.owner_node_, finish_.owner_node_ + 1);
         start_.Clear();
         finish_.Clear();
+        ReleaseData();
+    }
+    void ReleaseData() {
+        Clear();
+        DeallocateSpareArray();
+        if (map_ != nullptr) {
+            map_traits::deallocate(map_allocator_, map_, map_size_);
+        }
+        map_ = nullptr;
+        map_size_ = 0;
+    }
+    // Takes deq's storage, deq is left without map (as after default
+    // construction)
+    void StealData(Deque& deq) noexcept {
+        start_ = std::exchange(deq.start_, iterator());
+        finish_ = std::exchange(deq.finish_, iterator());
+        map_ = std::exchange(deq.map_, nullptr);
+        map_size_ = std::exchange(deq.map_size_, 0);
+        reserved_front_ = std::exchange(deq.reserved_front_, 0);
+        reserved_back_ = std::exchange(deq.reserved_back_, 0);
+        reserve_front_limit_ = std::exchange(deq.reserve_front_limit_, 0);
+        reserve_back_limit_ = std::exchange(deq.reserve_back_limit_, 0);
+        spare_nodes_ = std::exchange(deq.spare_nodes_, nullptr);
+        spare_size_ = std::exchange(deq.spare_size_, 0);
+        spare_depth_ = deq.spare_depth_;
+        stats_ = std::exchange(deq.stats_, DequeBlockStats{});
+    }
+    // Allocators are not touched
+    void SwapData(Deque& deq) noexcept {
+        std::swap(start_, deq.start_);
+        std::swap(finish_, deq.finish_);
+        std::swap(map_, deq.map_);
+        std::swap(map_size_, deq.map_size_);
+        std::swap(reserved_front_, deq.reserved_front_);
+        std::swap(reserved_back_, deq.reserved_back_);
+        std::swap(reserve_front_limit_, deq.reserve_front_limit_);
+        std::swap(reserve_back_limit_, deq.reserve_back_limit_);
+        std::swap(spare_nodes_, deq.spare_nodes_);
+        std::swap(spare_size_, deq.spare_size_);
+        std::swap(spare_depth_, deq.spare_depth_);
+        std::swap(stats_, deq.stats_);
     }
 };
 
+template<typename T, typename Allocator, typename BlockPolicy>
+void swap(Deque<T, Allocator, BlockPolicy>& lhs,
+          Deque<T, Allocator, BlockPolicy>& rhs) noexcept {
+    lhs.swap(rhs);
+}
+
+// Index iterator over a power-of-two ring: pos_ is the unmasked position
+// (ring head + offset), the slot is pos_ & mask_
+template<typename T, typename Ptr, typename Ref>
+class RingDequeIterator {
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef Ptr pointer;
+    typedef Ref reference;
+
+    typedef ptrdiff_t difference_type;
+    typedef RingDequeIterator<T, Ptr, Ref> self;
+
+  public:
+    RingDequeIterator() = default;
+    RingDequeIterator(T* slots, difference_type mask, difference_type pos) noexcept
+            : slots_(slots)
+            , mask_(mask)
+            , pos_(pos) {}
+
+    // NON-CONST -> CONST
+    constexpr operator RingDequeIterator<T, const T*, const T&>() const {
+        return RingDequeIterator<T, const T*, const T&>(slots_, mask_, pos_);
+    }
+
+    self& operator++() noexcept {
+        ++pos_;
+        return *this;
+    }
+    self& operator--() noexcept {
+        --pos_;
+        return *this;
+    }
+    self operator++(int) noexcept {
+        self res = *this;
+        ++pos_;
+        return res;
+    }
+    self operator--(int) noexcept {
+        self res = *this;
+        --pos_;
+        return res;
+    }
+    self& operator+=(const difference_type val) noexcept {
+        pos_ += val;
+        return *this;
+    }
+    self& operator-=(const difference_type val) noexcept {
+        pos_ -= val;
+        return *this;
+    }
+    self operator+(const difference_type val) const noexcept {
+        return self(slots_, mask_, pos_ + val);
+    }
+    friend self operator+(const difference_type val, const self& it) noexcept {
+        return it + val;
+    }
+    self operator-(const difference_type val) const noexcept {
+        return self(slots_, mask_, pos_ - val);
+    }
+    difference_type operator-(const self& it) const noexcept {
+        return pos_ - it.pos_;
+    }
+
+    reference operator*() const noexcept {
+        return slots_[pos_ & mask_];
+    }
+    pointer operator->() const noexcept {
+        return slots_ + (pos_ & mask_);
+    }
+    reference operator[](difference_type ind) const noexcept {
+        return slots_[(pos_ + ind) & mask_];
+    }
+
+    bool operator==(const self& it) const noexcept {
+        return pos_ == it.pos_;
+    }
+    bool operator!=(const self& it) const noexcept {
+        return pos_ != it.pos_;
+    }
+    bool operator<(const self& it) const noexcept {
+        return pos_ < it.pos_;
+    }
+    bool operator>(const self& it) const noexcept {
+        return pos_ > it.pos_;
+    }
+    bool operator<=(const self& it) const noexcept {
+        return pos_ <= it.pos_;
+    }
+    bool operator>=(const self& it) const noexcept {
+        return pos_ >= it.pos_;
+    }
+
+  private:
+    T* slots_{nullptr};
+    difference_type mask_{0};
+    difference_type pos_{0};
+};
+
+// Capacity > 0: slots live inside the object, their count is Capacity
+// rounded up to a power of two
+template<typename T, int64_t Capacity, typename Allocator>
+class RingDequeStorage {
+  protected:
+    static constexpr int64_t kSlots = DequeRoundUpPow2(Capacity);
+
+    RingDequeStorage() noexcept {}
+    RingDequeStorage(const RingDequeStorage&) noexcept {}
+    RingDequeStorage& operator=(const RingDequeStorage&) noexcept {
+        return *this;
+    }
+
+    T* Slots() noexcept {
+        return reinterpret_cast<T*>(slots_);
+    }
+    const T* Slots() const noexcept {
+        return reinterpret_cast<const T*>(slots_);
+    }
+    static constexpr int64_t Mask() noexcept {
+        return kSlots - 1;
+    }
+    static constexpr int64_t Limit() noexcept {
+        return Capacity;
+    }
+    template<typename... Args>
+    void Construct(T* slot, Args&&... args) {
+        ::new (static_cast<void*>(slot)) T(std::forward<Args>(args)...);
+    }
+    void Destroy(T* slot) noexcept {
+        slot->~T();
+    }
+
+  private:
+    alignas(T) unsigned char slots_[kSlots * sizeof(T)];
+};
+
+// Capacity == 0: slots come from the allocator, capacity is fixed at
+// construction
+template<typename T, typename Allocator>
+class RingDequeStorage<T, 0, Allocator> {
+  protected:
+    typedef std::allocator_traits<Allocator> data_traits;
+
+    RingDequeStorage() noexcept(noexcept(Allocator())) = default;
+    RingDequeStorage(int64_t capacity, const Allocator& alloc)
+            : data_allocator_(alloc)
+            , limit_(capacity) {
+        if (capacity < 0) {
+            throw std::invalid_argument("RingDeque error: negative capacity!");
+        }
+        if (capacity > 0) {
+            mask_ = DequeRoundUpPow2(capacity) - 1;
+            slots_ = data_traits::allocate(data_allocator_, mask_ + 1);
+        }
+    }
+    // Copies get slots of the same capacity, elements are copied by RingDeque
+    RingDequeStorage(const RingDequeStorage& other)
+            : RingDequeStorage(other.limit_,
+                  data_traits::select_on_container_copy_construction(other.data_allocator_)) {}
+    RingDequeStorage& operator=(const RingDequeStorage&) = delete;
+    ~RingDequeStorage() {
+        ReleaseSlots();
+    }
+
+    T* Slots() noexcept {
+        return slots_;
+    }
+    const T* Slots() const noexcept {
+        return slots_;
+    }
+    int64_t Mask() const noexcept {
+        return mask_;
+    }
+    int64_t Limit() const noexcept {
+        return limit_;
+    }
+    template<typename... Args>
+    void Construct(T* slot, Args&&... args) {
+        data_traits::construct(data_allocator_, slot, std::forward<Args>(args)...);
+    }
+    void Destroy(T* slot) noexcept {
+        data_traits::destroy(data_allocator_, slot);
+    }
+    // Slots must hold no elements
+    void ReleaseSlots() noexcept {
+        if (slots_ != nullptr) {
+            data_traits::deallocate(data_allocator_, slots_, mask_ + 1);
+        }
+        slots_ = nullptr;
+        mask_ = 0;
+        limit_ = 0;
+    }
+    // Allocators travel with the slots they allocated
+    void SwapSlots(RingDequeStorage& other) noexcept {
+        std::swap(data_allocator_, other.data_allocator_);
+        std::swap(slots_, other.slots_);
+        std::swap(mask_, other.mask_);
+        std::swap(limit_, other.limit_);
+    }
+
+    Allocator data_allocator_;
+
+  private:
+    T* slots_{nullptr};
+    int64_t mask_{0};
+    int64_t limit_{0};
+};
+
+// Bounded deque on a power-of-two ring: no map, no blocks, indexing is
+// one mask. RingDeque<T, N> keeps N elements inline, RingDeque<T> takes
+// its capacity at construction. Pushing into a full ring throws
+// std::length_error.
+template<typename T, int64_t Capacity = 0, typename Allocator = std::allocator<T>>
+class RingDeque : private RingDequeStorage<T, Capacity, Allocator> {
+    static_assert(Capacity >= 0, "RingDeque: negative capacity");
+
+    typedef RingDequeStorage<T, Capacity, Allocator> storage;
+
+  public:
+    typedef T value_type;
+    typedef Allocator allocator_type;
+    typedef T* pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+
+    typedef RingDequeIterator<T, T*, T&> iterator;
+    typedef RingDequeIterator<T, const T*, const T&> const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    typedef ptrdiff_t difference_type;
+
+    static constexpr bool kDynamic = Capacity == 0;
+
+  public:
+    RingDeque() = default;
+    template<int64_t C = Capacity, typename = typename std::enable_if<C == 0>::type>
+    explicit RingDeque(int64_t capacity, const Allocator& alloc = Allocator())
+            : storage(capacity, alloc) {}
+    template<int64_t C = Capacity, typename = typename std::enable_if<C != 0>::type>
+    RingDeque(std::initializer_list<T> val_list) {
+        AppendList(val_list);
+    }
+    template<int64_t C = Capacity, typename = typename std::enable_if<C == 0>::type>
+    RingDeque(int64_t capacity, std::initializer_list<T> val_list,
+              const Allocator& alloc = Allocator())
+            : storage(capacity, alloc) {
+        AppendList(val_list);
+    }
+    RingDeque(const RingDeque& other)
+            : storage(other) {
+        try {
+            for (const T& val : other) {
+                push_back(val);
+            }
+        } catch (...) {
+            clear();
+            throw;
+        }
+    }
+    // Dynamic rings hand their slots over, inline rings move element-wise
+    RingDeque(RingDeque&& other) noexcept(kDynamic ||
+                                          std::is_nothrow_move_constructible<T>::value) {
+        StealFrom(other);
+    }
+    ~RingDeque() {
+        clear();
+    }
+
+    RingDeque& operator=(const RingDeque& other) {
+        if (this != &other) {
+            RingDeque copy(other);
+            clear();
+            StealFrom(copy);
+        }
+        return *this;
+    }
+    RingDeque& operator=(RingDeque&& other) noexcept(
+            kDynamic || std::is_nothrow_move_constructible<T>::value) {
+        if (this != &other) {
+            clear();
+            StealFrom(other);
+        }
+        return *this;
+    }
+
+    int64_t size() const noexcept {
+        return size_;
+    }
+    bool empty() const noexcept {
+        return size_ == 0;
+    }
+    int64_t capacity() const noexcept {
+        return storage::Limit();
+    }
+    bool full() const noexcept {
+        return size_ == storage::Limit();
+    }
+
+    reference operator[](int64_t ind) noexcept {
+        return storage::Slots()[(head_ + ind) & storage::Mask()];
+    }
+    const T& operator[](int64_t ind) const noexcept {
+        return storage::Slots()[(head_ + ind) & storage::Mask()];
+    }
+    reference at(int64_t ind) {
+        if (ind < 0 || ind >= size_) {
+            throw std::out_of_range("RingDeque::at out of range!");
+        }
+        return (*this)[ind];
+    }
+    const T& at(int64_t ind) const {
+        if (ind < 0 || ind >= size_) {
+            throw std::out_of_range("RingDeque::at out of range!");
+        }
+        return (*this)[ind];
+    }
+
+    bool operator==(const RingDeque& other) const {
+        return size_ == other.size_ && std::equal(begin(), end(), other.begin());
+    }
+    bool operator!=(const RingDeque& other) const {
+        return !(*this == other);
+    }
+    bool operator<(const RingDeque& other) const {
+        return std::lexicographical_compare(begin(), end(), other.begin(), other.end());
+    }
+    bool operator>(const RingDeque& other) const {
+        return other < *this;
+    }
+    bool operator<=(const RingDeque& other) const {
+        return !(other < *this);
+    }
+    bool operator>=(const RingDeque& other) const {
+        return !(*this < other);
+    }
+
+    reference front() {
+        if (empty()) {
+            throw std::runtime_error("RingDeque::front error: deque is empty!");
+        }
+        return (*this)[0];
+    }
+    const T& front() const {
+        if (empty()) {
+            throw std::runtime_error("RingDeque::front error: deque is empty!");
+        }
+        return (*this)[0];
+    }
+    reference back() {
+        if (empty()) {
+            throw std::runtime_error("RingDeque::back error: deque is empty!");
+        }
+        return (*this)[size_ - 1];
+    }
+    const T& back() const {
+        if (empty()) {
+            throw std::runtime_error("RingDeque::back error: deque is empty!");
+        }
+        return (*this)[size_ - 1];
+    }
+
+    iterator begin() noexcept {
+        return iterator(storage::Slots(), storage::Mask(), head_);
+    }
+    const_iterator begin() const noexcept {
+        return cbegin();
+    }
+    const_iterator cbegin() const noexcept {
+        return const_iterator(const_cast<T*>(storage::Slots()), storage::Mask(), head_);
+    }
+    iterator end() noexcept {
+        return iterator(storage::Slots(), storage::Mask(), head_ + size_);
+    }
+    const_iterator end() const noexcept {
+        return cend();
+    }
+    const_iterator cend() const noexcept {
+        return const_iterator(const_cast<T*>(storage::Slots()), storage::Mask(), head_ + size_);
+    }
+    reverse_iterator rbegin() noexcept {
+        return reverse_iterator(end());
+    }
+    const_reverse_iterator rbegin() const noexcept {
+        return const_reverse_iterator(cend());
+    }
+    const_reverse_iterator crbegin() const noexcept {
+        return const_reverse_iterator(cend());
+    }
+    reverse_iterator rend() noexcept {
+        return reverse_iterator(begin());
+    }
+    const_reverse_iterator rend() const noexcept {
+        return const_reverse_iterator(cbegin());
+    }
+    const_reverse_iterator crend() const noexcept {
+        return const_reverse_iterator(cbegin());
+    }
+
+    void push_front(const T& val) {
+        emplace_front(val);
+    }
+    void push_front(T&& val) {
+        emplace_front(std::move(val));
+    }
+    void push_back(const T& val) {
+        emplace_back(val);
+    }
+    void push_back(T&& val) {
+        emplace_back(std::move(val));
+    }
+
+    template<typename... Args>
+    reference emplace_front(Args&&... args) {
+        if (full()) {
+            throw std::length_error("RingDeque::emplace_front error: deque is full!");
+        }
+        int64_t new_head = (head_ - 1) & storage::Mask();
+        T* slot = storage::Slots() + new_head;
+        storage::Construct(slot, std::forward<Args>(args)...);
+        head_ = new_head;
+        ++size_;
+        return *slot;
+    }
+    template<typename... Args>
+    reference emplace_back(Args&&... args) {
+        if (full()) {
+            throw std::length_error("RingDeque::emplace_back error: deque is full!");
+        }
+        T* slot = storage::Slots() + ((head_ + size_) & storage::Mask());
+        storage::Construct(slot, std::forward<Args>(args)...);
+        ++size_;
+        return *slot;
+    }
+
+    void pop_front() {
+        if (empty()) {
+            throw std::runtime_error("RingDeque::pop_front error: deque is empty!");
+        }
+        storage::Destroy(storage::Slots() + head_);
+        head_ = (head_ + 1) & storage::Mask();
+        --size_;
+    }
+    void pop_back() {
+        if (empty()) {
+            throw std::runtime_error("RingDeque::pop_back error: deque is empty!");
+        }
+        --size_;
+        storage::Destroy(storage::Slots() + ((head_ + size_) & storage::Mask()));
+    }
+
+    void clear() noexcept {
+        if constexpr (!std::is_trivially_destructible<T>::value) {
+            for (int64_t i = 0; i < size_; ++i) {
+                storage::Destroy(&(*this)[i]);
+            }
+        }
+        head_ = 0;
+        size_ = 0;
+    }
+
+    void swap(RingDeque& other) noexcept(kDynamic) {
+        if constexpr (kDynamic) {
+            storage::SwapSlots(other);
+            std::swap(head_, other.head_);
+            std::swap(size_, other.size_);
+        } else {
+            std::swap(*this, other);
+        }
+    }
+
+  private:
+    int64_t head_{0};
+    int64_t size_{0};
+
+    void AppendList(std::initializer_list<T> val_list) {
+        if (int64_t(val_list.size()) > capacity()) {
+            throw std::length_error("RingDeque error: initializer list exceeds capacity!");
+        }
+        try {
+            for (const T& val : val_list) {
+                push_back(val);
+            }
+        } catch (...) {
+            clear();
+            throw;
+        }
+    }
+    // *this must be empty
+    void StealFrom(RingDeque& other) noexcept(kDynamic ||
+                                              std::is_nothrow_move_constructible<T>::value) {
+        if constexpr (kDynamic) {
+            storage::ReleaseSlots();
+            storage::SwapSlots(other);
+            head_ = std::exchange(other.head_, 0);
+            size_ = std::exchange(other.size_, 0);
+        } else {
+            if constexpr (std::is_nothrow_move_constructible<T>::value) {
+                MoveElemsFrom(other);
+            } else {
+                try {
+                    MoveElemsFrom(other);
+                } catch (...) {
+                    clear();
+                    throw;
+                }
+            }
+            other.clear();
+        }
+    }
+    void MoveElemsFrom(RingDeque& other) {
+        for (T& val : other) {
+            push_back(std::move(val));
+        }
+    }
+};
+
+template<typename T, int64_t Capacity, typename Allocator>
+void swap(RingDeque<T, Capacity, Allocator>& lhs,
+          RingDeque<T, Capacity, Allocator>& rhs) noexcept(Capacity == 0) {
+    lhs.swap(rhs);
+}
+
+// Index iterator: dereference goes through the owner's operator[], which
+// picks the inline ring or the spilled Deque
+template<typename Owner, typename T, typename Ptr, typename Ref>
+class SmallDequeIterator {
+  public:
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef T value_type;
+    typedef Ptr pointer;
+    typedef Ref reference;
+
+    typedef ptrdiff_t difference_type;
+    typedef SmallDequeIterator<Owner, T, Ptr, Ref> self;
+
+  public:
+    SmallDequeIterator() = default;
+    SmallDequeIterator(Owner* owner, difference_type ind) noexcept
+            : owner_(owner)
+            , ind_(ind) {}
+
+    // NON-CONST -> CONST
+    constexpr operator SmallDequeIterator<const Owner, T, const T*, const T&>() const {
+        return SmallDequeIterator<const Owner, T, const T*, const T&>(owner_, ind_);
+    }
+
+    self& operator++() noexcept {
+        ++ind_;
+        return *this;
+    }
+    self& operator--() noexcept {
+        --ind_;
+        return *this;
+    }
+    self operator++(int) noexcept {
+        self res = *this;
+        ++ind_;
+        return res;
+    }
+    self operator--(int) noexcept {
+        self res = *this;
+        --ind_;
+        return res;
+    }
+    self& operator+=(const difference_type val) noexcept {
+        ind_ += val;
+        return *this;
+    }
+    self& operator-=(const difference_type val) noexcept {
+        ind_ -= val;
+        return *this;
+    }
+    self operator+(const difference_type val) const noexcept {
+        return self(owner_, ind_ + val);
+    }
+    friend self operator+(const difference_type val, const self& it) noexcept {
+        return it + val;
+    }
+    self operator-(const difference_type val) const noexcept {
+        return self(owner_, ind_ - val);
+    }
+    difference_type operator-(const self& it) const noexcept {
+        return ind_ - it.ind_;
+    }
+
+    reference operator*() const noexcept {
+        return (*owner_)[ind_];
+    }
+    pointer operator->() const noexcept {
+        return &(*owner_)[ind_];
+    }
+    reference operator[](difference_type ind) const noexcept {
+        return (*owner_)[ind_ + ind];
+    }
+
+    bool operator==(const self& it) const noexcept {
+        return ind_ == it.ind_;
+    }
+    bool operator!=(const self& it) const noexcept {
+        return ind_ != it.ind_;
+    }
+    bool operator<(const self& it) const noexcept {
+        return ind_ < it.ind_;
+    }
+    bool operator>(const self& it) const noexcept {
+        return ind_ > it.ind_;
+    }
+    bool operator<=(const self& it) const noexcept {
+        return ind_ <= it.ind_;
+    }
+    bool operator>=(const self& it) const noexcept {
+        return ind_ >= it.ind_;
+    }
+
+  private:
+    Owner* owner_{nullptr};
+    difference_type ind_{0};
+};
+
+// Up to InlineSize elements live in an inline RingDeque, no allocation at
+// all. The first push past that moves everything into a Deque, which is
+// kept from then on (clear() does not go back to inline storage).
+template<typename T, int64_t InlineSize, typename Allocator = std::allocator<T>>
+class SmallDeque {
+    static_assert(InlineSize > 0, "SmallDeque: inline size must be positive");
+
+  public:
+    typedef T value_type;
+    typedef Allocator allocator_type;
+    typedef T* pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+
+    typedef RingDeque<T, InlineSize, Allocator> small_type;
+    typedef Deque<T, Allocator> large_type;
+    typedef SmallDequeIterator<SmallDeque, T, T*, T&> iterator;
+    typedef SmallDequeIterator<const SmallDeque, T, const T*, const T&> const_iterator;
+    typedef std::reverse_iterator<iterator> reverse_iterator;
+    typedef std::reverse_iterator<const_iterator> const_reverse_iterator;
+
+    typedef ptrdiff_t difference_type;
+
+  public:
+    SmallDeque() noexcept {
+        ::new (static_cast<void*>(&small_)) small_type();
+    }
+    SmallDeque(std::initializer_list<T> val_list)
+            : SmallDeque() {
+        for (const T& val : val_list) {
+            push_back(val);
+        }
+    }
+    SmallDeque(const SmallDeque& other) {
+        if (other.is_small_) {
+            ::new (static_cast<void*>(&small_)) small_type(other.small_);
+        } else {
+            ::new (static_cast<void*>(&large_)) large_type(other.large_);
+        }
+        is_small_ = other.is_small_;
+    }
+    SmallDeque(SmallDeque&& other) noexcept(std::is_nothrow_move_constructible<T>::value) {
+        StealFrom(other);
+    }
+    ~SmallDeque() {
+        DestroyStorage();
+    }
+
+    SmallDeque& operator=(const SmallDeque& other) {
+        if (this != &other) {
+            SmallDeque copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+    SmallDeque& operator=(SmallDeque&& other) noexcept(
+            std::is_nothrow_move_constructible<T>::value) {
+        if (this == &other) {
+            return *this;
+        }
+        if (!other.is_small_) {
+            // The Deque is handed over, nothing throws
+            DestroyStorage();
+            StealFrom(other);
+            return *this;
+        }
+        // Element-wise move may throw: *this is an empty inline ring by then
+        if (!is_small_) {
+            large_.~large_type();
+            ::new (static_cast<void*>(&small_)) small_type();
+            is_small_ = true;
+        }
+        small_ = std::move(other.small_);
+        return *this;
+    }
+
+    bool is_inline() const noexcept {
+        return is_small_;
+    }
+    static constexpr int64_t inline_capacity() noexcept {
+        return InlineSize;
+    }
+
+    int64_t size() const noexcept {
+        return is_small_ ? small_.size() : large_.size();
+    }
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+
+    reference operator[](int64_t ind) noexcept {
+        return is_small_ ? small_[ind] : large_[ind];
+    }
+    const T& operator[](int64_t ind) const noexcept {
+        return is_small_ ? small_[ind] : large_[ind];
+    }
+    reference at(int64_t ind) {
+        if (ind < 0 || ind >= size()) {
+            throw std::out_of_range("SmallDeque::at out of range!");
+        }
+        return (*this)[ind];
+    }
+    const T& at(int64_t ind) const {
+        if (ind < 0 || ind >= size()) {
+            throw std::out_of_range("SmallDeque::at out of range!");
+        }
+        return (*this)[ind];
+    }
+
+    bool operator==(const SmallDeque& other) const {
+        return size() == other.size() && std::equal(begin(), end(), other.begin());
+    }
+    bool operator!=(const SmallDeque& other) const {
+        return !(*this == other);
+    }
+    bool operator<(const SmallDeque& other) const {
+        return std::lexicographical_compare(begin(), end(), other.begin(), other.end());
+    }
+    bool operator>(const SmallDeque& other) const {
+        return other < *this;
+    }
+    bool operator<=(const SmallDeque& other) const {
+        return !(other < *this);
+    }
+    bool operator>=(const SmallDeque& other) const {
+        return !(*this < other);
+    }
+
+    reference front() {
+        return is_small_ ? small_.front() : large_.front();
+    }
+    const T& front() const {
+        return is_small_ ? small_.front() : large_.front();
+    }
+    reference back() {
+        return is_small_ ? small_.back() : large_.back();
+    }
+    const T& back() const {
+        return is_small_ ? small_.back() : large_.back();
+    }
+
+    iterator begin() noexcept {
+        return iterator(this, 0);
+    }
+    const_iterator begin() const noexcept {
+        return cbegin();
+    }
+    const_iterator cbegin() const noexcept {
+        return const_iterator(this, 0);
+    }
+    iterator end() noexcept {
+        return iterator(this, size());
+    }
+    const_iterator end() const noexcept {
+        return cend();
+    }
+    const_iterator cend() const noexcept {
+        return const_iterator(this, size());
+    }
+    reverse_iterator rbegin() noexcept {
+        return reverse_iterator(end());
+    }
+    const_reverse_iterator rbegin() const noexcept {
+        return const_reverse_iterator(cend());
+    }
+    const_reverse_iterator crbegin() const noexcept {
+        return const_reverse_iterator(cend());
+    }
+    reverse_iterator rend() noexcept {
+        return reverse_iterator(begin());
+    }
+    const_reverse_iterator rend() const noexcept {
+        return const_reverse_iterator(cbegin());
+    }
+    const_reverse_iterator crend() const noexcept {
+        return const_reverse_iterator(cbegin());
+    }
+
+    void push_front(const T& val) {
+        emplace_front(val);
+    }
+    void push_front(T&& val) {
+        emplace_front(std::move(val));
+    }
+    void push_back(const T& val) {
+        emplace_back(val);
+    }
+    void push_back(T&& val) {
+        emplace_back(std::move(val));
+    }
+
+    template<typename... Args>
+    reference emplace_front(Args&&... args) {
+        if (is_small_ && !small_.full()) {
+            return small_.emplace_front(std::forward<Args>(args)...);
+        }
+        if (is_small_) {
+            // args may refer to an inline element: build the value first
+            T val(std::forward<Args>(args)...);
+            Spill();
+            return large_.emplace_front(std::move(val));
+        }
+        return large_.emplace_front(std::forward<Args>(args)...);
+    }
+    template<typename... Args>
+    reference emplace_back(Args&&... args) {
+        if (is_small_ && !small_.full()) {
+            return small_.emplace_back(std::forward<Args>(args)...);
+        }
+        if (is_small_) {
+            T val(std::forward<Args>(args)...);
+            Spill();
+            return large_.emplace_back(std::move(val));
+        }
+        return large_.emplace_back(std::forward<Args>(args)...);
+    }
+
+    void pop_front() {
+        if (is_small_) {
+            small_.pop_front();
+        } else {
+            large_.pop_front();
+        }
+    }
+    void pop_back() {
+        if (is_small_) {
+            small_.pop_back();
+        } else {
+            large_.pop_back();
+        }
+    }
+    void clear() noexcept {
+        if (is_small_) {
+            small_.clear();
+        } else {
+            large_.clear();
+        }
+    }
+
+    void swap(SmallDeque& other) noexcept(std::is_nothrow_move_constructible<T>::value) {
+        SmallDeque tmp(std::move(other));
+        other = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+  private:
+    union {
+        small_type small_;
+        large_type large_;
+    };
+    bool is_small_{true};
+
+    // Moves the inline elements into a Deque; the ring is untouched if
+    // that throws (elements are copied unless their move is noexcept)
+    void Spill() {
+        large_type large;
+        if constexpr (std::is_nothrow_move_constructible<T>::value) {
+            large.append_back(std::make_move_iterator(small_.begin()),
+                              std::make_move_iterator(small_.end()));
+        } else {
+            large.append_back(small_.begin(), small_.end());
+        }
+        small_.~small_type();
+        ::new (static_cast<void*>(&large_)) large_type(std::move(large));
+        is_small_ = false;
+    }
+    void DestroyStorage() noexcept {
+        if (is_small_) {
+            small_.~small_type();
+        } else {
+            large_.~large_type();
+        }
+    }
+    // *this has no live storage; other is left empty and inline
+    void StealFrom(SmallDeque& other) noexcept(std::is_nothrow_move_constructible<T>::value) {
+        if (other.is_small_) {
+            ::new (static_cast<void*>(&small_)) small_type(std::move(other.small_));
+            is_small_ = true;
+        } else {
+            ::new (static_cast<void*>(&large_)) large_type(std::move(other.large_));
+            is_small_ = false;
+            other.large_.~large_type();
+            ::new (static_cast<void*>(&other.small_)) small_type();
+            other.is_small_ = true;
+        }
+    }
+};
+
+template<typename T, int64_t InlineSize, typename Allocator>
+void swap(SmallDeque<T, InlineSize, Allocator>& lhs,
+          SmallDeque<T, InlineSize, Allocator>& rhs) noexcept(
+                std::is_nothrow_move_constructible<T>::value) {
+    lhs.swap(rhs);
+}
+
 #endif /* MYDEQUE_H */
\ No newline at end of file
@@ -0,0 +1,837 @@
+#include "deque.hpp"
+#include "deque_simd.hpp"
+#include "work_stealing_deque.hpp"
+#include "spsc_deque.hpp"
+#include "concurrent_deque.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+volatile int64_t sink = 0;
+
+template<typename Func>
+double MeasureMs(Func&& func) {
+    auto begin = std::chrono::steady_clock::now();
+    func();
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+void PrintResult(const char* name, int64_t ops, double ms) {
+    std::printf("%-44s %10.2f ms %10.2f Mops/s\n", name, ms, double(ops) / ms / 1000.0);
+}
+
+struct Order {
+    int64_t id;
+    double price;
+    char payload[284];
+};
+
+// push_back everything, scan it once, pop_front everything
+template<typename T, typename Policy>
+void BenchBlockSize(const char* name, int64_t elems) {
+    double ms = MeasureMs([elems] {
+        Deque<T, std::allocator<T>, Policy> d;
+        for (int64_t i = 0; i < elems; ++i) {
+            d.push_back(T{});
+        }
+        int64_t sum = 0;
+        for (const T& elem : d) {
+            sum += reinterpret_cast<const char&>(elem);
+        }
+        while (!d.empty()) {
+            d.pop_front();
+        }
+        sink = sink + sum;
+    });
+
+    char full_name[128];
+    std::snprintf(full_name, sizeof(full_name), "%s (block = %ld elems)", name,
+                  long(Deque<T, std::allocator<T>, Policy>::block_size()));
+    PrintResult(full_name, 3 * elems, ms);
+}
+
+void BenchBlockSizes() {
+    std::printf("--- Block size: push_back / scan / pop_front ---\n");
+    const int64_t kOrders = 1'000'000;
+    BenchBlockSize<Order, DequeDefaultBlock>("Order, default", kOrders);
+    BenchBlockSize<Order, DequeBlockBytes<4096>>("Order, 4 KiB", kOrders);
+    BenchBlockSize<Order, DequeBlockBytes<64 * 1024>>("Order, 64 KiB", kOrders);
+    BenchBlockSize<Order, DequeBlockBytes<2 * 1024 * 1024>>("Order, 2 MiB", kOrders);
+
+    const int64_t kBytes = 64'000'000;
+    BenchBlockSize<char, DequeDefaultBlock>("char, default", kBytes);
+    BenchBlockSize<char, DequeBlockBytes<64 * 1024>>("char, 64 KiB", kBytes);
+    BenchBlockSize<char, DequeBlockBytes<2 * 1024 * 1024>>("char, 2 MiB", kBytes);
+}
+
+template<typename DequeType>
+void BenchRandomAccess(const char* name) {
+    const int64_t kElems = 4'000'000;
+    const int64_t kReads = 40'000'000;
+    DequeType d;
+    for (int64_t i = 0; i < kElems; ++i) {
+        d.push_back(typename DequeType::value_type{});
+    }
+
+    double ms = MeasureMs([&d] {
+        int64_t sum = 0;
+        uint64_t ind = 12345;
+        for (int64_t i = 0; i < kReads; ++i) {
+            // xorshift keeps indexes unpredictable but cheap
+            ind ^= ind << 13;
+            ind ^= ind >> 7;
+            ind ^= ind << 17;
+            sum += d[int64_t(ind % kElems)].key;
+        }
+        sink = sink + sum;
+    });
+
+    char full_name[128];
+    std::snprintf(full_name, sizeof(full_name), "%s (block = %ld elems)", name,
+                  long(DequeType::block_size()));
+    PrintResult(full_name, kReads, ms);
+}
+
+struct Tick {
+    int32_t key;
+    int32_t qty;
+    int32_t side;
+};
+
+void BenchPow2Blocks() {
+    std::printf("--- operator[]: random reads ---\n");
+    BenchRandomAccess<Deque<Tick>>("Tick, default block");
+    BenchRandomAccess<Deque<Tick, std::allocator<Tick>, DequePow2Block<DequeDefaultBlock>>>(
+                      "Tick, power of two block");
+}
+
+void BenchAppend() {
+    std::printf("--- Batches of 4096 int64_t: push_back loop vs append_back ---\n");
+    const int64_t kBatches = 16'000;
+    std::vector<int64_t> batch(4096);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        batch[i] = int64_t(i);
+    }
+
+    double ms = MeasureMs([&batch] {
+        Deque<int64_t> d;
+        for (int64_t i = 0; i < kBatches; ++i) {
+            for (int64_t val : batch) {
+                d.push_back(val);
+            }
+        }
+        sink = sink + d.back();
+    });
+    PrintResult("push_back loop", kBatches * int64_t(batch.size()), ms);
+
+    ms = MeasureMs([&batch] {
+        Deque<int64_t> d;
+        for (int64_t i = 0; i < kBatches; ++i) {
+            d.append_back(batch.data(), batch.data() + batch.size());
+        }
+        sink = sink + d.back();
+    });
+    PrintResult("append_back", kBatches * int64_t(batch.size()), ms);
+
+    ms = MeasureMs([&batch] {
+        Deque<int64_t> d;
+        for (int64_t i = 0; i < kBatches; ++i) {
+            d.append_front(batch.data(), batch.data() + batch.size());
+        }
+        sink = sink + d.back();
+    });
+    PrintResult("append_front", kBatches * int64_t(batch.size()), ms);
+}
+
+template<typename Iter>
+void BenchIterators(const char* name, Iter begin, Iter end) {
+    const int64_t elems = end - begin;
+    char full_name[128];
+
+    double ms = MeasureMs([begin, end] {
+        int64_t sum = 0;
+        for (int run = 0; run < 10; ++run) {
+            for (Iter it = begin; it != end; ++it) {
+                sum += *it;
+            }
+        }
+        sink = sink + sum;
+    });
+    std::snprintf(full_name, sizeof(full_name), "%s: sequential scan", name);
+    PrintResult(full_name, 10 * elems, ms);
+
+    ms = MeasureMs([begin, elems] {
+        int64_t sum = 0;
+        uint64_t ind = 12345;
+        for (int64_t i = 0; i < 10 * elems; ++i) {
+            ind ^= ind << 13;
+            ind ^= ind >> 7;
+            ind ^= ind << 17;
+            sum += begin[int64_t(ind % elems)];
+        }
+        sink = sink + sum;
+    });
+    std::snprintf(full_name, sizeof(full_name), "%s: random access", name);
+    PrintResult(full_name, 10 * elems, ms);
+
+    ms = MeasureMs([begin, end] {
+        std::sort(begin, end);
+    });
+    std::snprintf(full_name, sizeof(full_name), "%s: std::sort", name);
+    PrintResult(full_name, elems, ms);
+}
+
+void FillShuffled(Deque<int64_t>& d, int64_t elems) {
+    d.pop_back(d.size());
+    uint64_t val = 88172645463325252ULL;
+    for (int64_t i = 0; i < elems; ++i) {
+        val ^= val << 13;
+        val ^= val >> 7;
+        val ^= val << 17;
+        d.push_back(int64_t(val >> 20));
+    }
+}
+
+void BenchCompactIterator() {
+    std::printf("--- DequeIterator vs DequeCompactIterator (int64_t) ---\n");
+    const int64_t kElems = 4'000'000;
+    Deque<int64_t> d;
+
+    FillShuffled(d, kElems);
+    BenchIterators("iterator", d.begin(), d.end());
+    FillShuffled(d, kElems);
+    BenchIterators("compact_iterator", d.compact_begin(), d.compact_end());
+}
+
+void BenchSegments() {
+    std::printf("--- Sum of 16M int32_t: iterator vs for_each_segment ---\n");
+    const int64_t kElems = 16'000'000;
+    Deque<int32_t> d;
+    for (int64_t i = 0; i < kElems; ++i) {
+        d.push_back(int32_t(i & 0xff));
+    }
+
+    double ms = MeasureMs([&d] {
+        int64_t sum = 0;
+        for (int run = 0; run < 10; ++run) {
+            for (int32_t elem : d) {
+                sum += elem;
+            }
+        }
+        sink = sink + sum;
+    });
+    PrintResult("iterator loop", 10 * kElems, ms);
+
+    ms = MeasureMs([&d] {
+        int64_t sum = 0;
+        for (int run = 0; run < 10; ++run) {
+            d.for_each_segment([&sum](DequeSpan<const int32_t> segment) {
+                int64_t segment_sum = 0;
+                for (int32_t elem : segment) {
+                    segment_sum += elem;
+                }
+                sum += segment_sum;
+            });
+        }
+        sink = sink + sum;
+    });
+    PrintResult("for_each_segment", 10 * kElems, ms);
+}
+
+void BenchAlgorithms() {
+    std::printf("--- 16M int32_t: std:: vs deque_algo:: ---\n");
+    const int64_t kElems = 16'000'000;
+    Deque<int32_t> d;
+    Deque<int32_t> dest(kElems);
+    for (int64_t i = 0; i < kElems; ++i) {
+        d.push_back(int32_t(i & 0xff));
+    }
+
+    double ms = MeasureMs([&] { std::copy(d.begin(), d.end(), dest.begin()); });
+    PrintResult("std::copy", kElems, ms);
+    ms = MeasureMs([&] { deque_algo::copy(d.begin(), d.end(), dest.begin()); });
+    PrintResult("deque_algo::copy", kElems, ms);
+
+    ms = MeasureMs([&] { std::fill(dest.begin(), dest.end(), 1); });
+    PrintResult("std::fill", kElems, ms);
+    ms = MeasureMs([&] { deque_algo::fill(dest.begin(), dest.end(), 1); });
+    PrintResult("deque_algo::fill", kElems, ms);
+
+    ms = MeasureMs([&] { sink = sink + (std::find(d.begin(), d.end(), -1) - d.begin()); });
+    PrintResult("std::find", kElems, ms);
+    ms = MeasureMs([&] {
+        sink = sink + (deque_algo::find(d.begin(), d.end(), -1) - d.begin());
+    });
+    PrintResult("deque_algo::find", kElems, ms);
+
+    ms = MeasureMs([&] { sink = sink + std::accumulate(d.begin(), d.end(), int64_t(0)); });
+    PrintResult("std::accumulate", kElems, ms);
+    ms = MeasureMs([&] {
+        sink = sink + deque_algo::accumulate(d.begin(), d.end(), int64_t(0));
+    });
+    PrintResult("deque_algo::accumulate", kElems, ms);
+}
+
+void BenchSimd() {
+    std::printf("--- 256K int64_t / double (cache resident, x100 runs): iterator vs deque_simd ---\n");
+    const int64_t kElems = 256 * 1024;
+    const int kRuns = 100;
+    Deque<int64_t> prices;
+    Deque<double> values;
+    for (int64_t i = 0; i < kElems; ++i) {
+        prices.push_back((i * 7919) % 100'003);
+        values.push_back(double((i * 7919) % 100'003) * 0.25);
+    }
+
+    double ms = MeasureMs([&] {
+        for (int run = 0; run < kRuns; ++run) {
+            sink = sink + (std::find(prices.cbegin(), prices.cend(), -1) - prices.cbegin());
+        }
+    });
+    PrintResult("find int64_t: iterator", kRuns * kElems, ms);
+    ms = MeasureMs([&] {
+        for (int run = 0; run < kRuns; ++run) {
+            int64_t count = 0;
+            for (int64_t price : prices) {
+                count += price < 50'000;
+            }
+            sink = sink + count;
+        }
+    });
+    PrintResult("count_less int64_t: iterator", kRuns * kElems, ms);
+    ms = MeasureMs([&] {
+        for (int run = 0; run < kRuns; ++run) {
+            double res = 0;
+            for (double val : values) {
+                res = std::max(res, val);
+            }
+            sink = sink + int64_t(res);
+        }
+    });
+    PrintResult("max double: iterator", kRuns * kElems, ms);
+    ms = MeasureMs([&] {
+        for (int run = 0; run < kRuns; ++run) {
+            sink = sink + int64_t(std::accumulate(values.cbegin(), values.cend(), 0.0));
+        }
+    });
+    PrintResult("sum double: iterator", kRuns * kElems, ms);
+
+    const char* kLevelNames[] = {"scalar", "sse2", "avx2"};
+    for (auto level : {deque_simd::SimdLevel::kScalar, deque_simd::SimdLevel::kSse2,
+                       deque_simd::SimdLevel::kAvx2}) {
+        if (deque_simd::set_simd_level(level) != level) {
+            continue;
+        }
+        const char* name = kLevelNames[int(level)];
+        char label[64];
+
+        ms = MeasureMs([&] {
+            for (int run = 0; run < kRuns; ++run) {
+                sink = sink + (deque_simd::find(prices, -1) - prices.cbegin());
+            }
+        });
+        std::snprintf(label, sizeof(label), "find int64_t: deque_simd %s", name);
+        PrintResult(label, kRuns * kElems, ms);
+        ms = MeasureMs([&] {
+            for (int run = 0; run < kRuns; ++run) {
+                sink = sink + deque_simd::count_less(prices, 50'000);
+            }
+        });
+        std::snprintf(label, sizeof(label), "count_less int64_t: deque_simd %s", name);
+        PrintResult(label, kRuns * kElems, ms);
+        ms = MeasureMs([&] {
+            for (int run = 0; run < kRuns; ++run) {
+                sink = sink + int64_t(deque_simd::max(values));
+            }
+        });
+        std::snprintf(label, sizeof(label), "max double: deque_simd %s", name);
+        PrintResult(label, kRuns * kElems, ms);
+        ms = MeasureMs([&] {
+            for (int run = 0; run < kRuns; ++run) {
+                sink = sink + int64_t(deque_simd::sum(values));
+            }
+        });
+        std::snprintf(label, sizeof(label), "sum double: deque_simd %s", name);
+        PrintResult(label, kRuns * kElems, ms);
+    }
+}
+
+template<typename Container>
+void BenchMiddleInsert(const char* name) {
+    const int64_t kElems = 20'000;
+    const int64_t kInserts = 2'000;
+    Container strings;
+    for (int64_t i = 0; i < kElems; ++i) {
+        strings.push_back(std::string(40, char('a' + i % 26)));
+    }
+    std::string val(40, 'z');
+    double ms = MeasureMs([&] {
+        for (int64_t i = 0; i < kInserts; ++i) {
+            strings.insert(strings.begin() + strings.size() / 2, val);
+            strings.erase(strings.begin() + strings.size() / 3);
+        }
+    });
+    sink = sink + int64_t(strings.size());
+    PrintResult(name, kInserts, ms);
+}
+
+template<typename Container>
+void BenchSplice(const char* name) {
+    const int64_t kElems = 1'000'000;
+    const int64_t kSplice = 100'000;
+    std::vector<int64_t> source(kSplice, 42);
+    Container d;
+    for (int64_t i = 0; i < kElems; ++i) {
+        d.push_back(i);
+    }
+    double ms = MeasureMs([&] {
+        for (int run = 0; run < 10; ++run) {
+            d.insert(d.begin() + d.size() / 3, source.begin(), source.end());
+        }
+    });
+    sink = sink + int64_t(d.size());
+    PrintResult(name, 10 * kSplice, ms);
+}
+
+void BenchReuse() {
+    std::printf("--- 1M requests of 64 int64_t: fresh deque vs clear() reuse ---\n");
+    const int64_t kRequests = 1'000'000;
+    double ms = MeasureMs([] {
+        for (int64_t request = 0; request < kRequests; ++request) {
+            Deque<int64_t> d;
+            for (int64_t i = 0; i < 64; ++i) {
+                d.push_back(i);
+            }
+            sink = sink + d.back();
+        }
+    });
+    PrintResult("fresh Deque per request", kRequests, ms);
+    ms = MeasureMs([] {
+        Deque<int64_t> d;
+        for (int64_t request = 0; request < kRequests; ++request) {
+            for (int64_t i = 0; i < 64; ++i) {
+                d.push_back(i);
+            }
+            sink = sink + d.back();
+            d.clear();
+        }
+    });
+    PrintResult("Deque::clear() reuse", kRequests, ms);
+    ms = MeasureMs([] {
+        std::deque<int64_t> d;
+        for (int64_t request = 0; request < kRequests; ++request) {
+            for (int64_t i = 0; i < 64; ++i) {
+                d.push_back(i);
+            }
+            sink = sink + d.back();
+            d.clear();
+        }
+    });
+    PrintResult("std::deque::clear() reuse", kRequests, ms);
+}
+
+void BenchConstruction() {
+    std::printf("--- Construct 32M int64_t ---\n");
+    const int64_t kElems = 32'000'000;
+    // Warm-up: the first run would pay page faults for fresh memory
+    sink = sink + Deque<int64_t>(kElems, 1)[0];
+    double ms = MeasureMs([] {
+        Deque<int64_t> d(kElems);
+        sink = sink + d[kElems / 2];
+    });
+    PrintResult("Deque(size)", kElems, ms);
+    ms = MeasureMs([] {
+        Deque<int64_t> d(kElems, 7);
+        sink = sink + d[kElems / 2];
+    });
+    PrintResult("Deque(size, val)", kElems, ms);
+    ms = MeasureMs([] {
+        Deque<int64_t> d(kElems, deque_default_init);
+        d[kElems / 2] = 1;
+        sink = sink + d[kElems / 2];
+    });
+    PrintResult("Deque(size, deque_default_init)", kElems, ms);
+    ms = MeasureMs([] {
+        std::deque<int64_t> d(kElems, 7);
+        sink = sink + d[kElems / 2];
+    });
+    PrintResult("std::deque(size, val)", kElems, ms);
+}
+
+void BenchCopy() {
+    std::printf("--- Copy 3M elements (x10) ---\n");
+    const int64_t kElems = 3'000'000;
+    Deque<int> d(kElems);
+    std::deque<int> std_d(kElems);
+    double ms = MeasureMs([&] {
+        for (int run = 0; run < 10; ++run) {
+            Deque<int> copy(d);
+            sink = sink + copy.back();
+        }
+    });
+    PrintResult("Deque<int> copy", 10 * kElems, ms);
+    ms = MeasureMs([&] {
+        for (int run = 0; run < 10; ++run) {
+            std::deque<int> copy(std_d);
+            sink = sink + copy.back();
+        }
+    });
+    PrintResult("std::deque<int> copy", 10 * kElems, ms);
+
+    Deque<std::string> strings(kElems, "short");
+    ms = MeasureMs([&] {
+        Deque<std::string> copy(strings);
+        sink = sink + int64_t(copy.back().size());
+    });
+    PrintResult("Deque<std::string> copy", kElems, ms);
+}
+
+void BenchCompare() {
+    std::printf("--- Compare 3M int64_t, different block offsets (x10) ---\n");
+    const int64_t kElems = 3'000'000;
+    Deque<int64_t> lhs, rhs;
+    for (int64_t i = 0; i < kElems; ++i) {
+        lhs.push_back(i);
+        rhs.push_front(kElems - 1 - i);
+    }
+    double ms = MeasureMs([&] {
+        for (int run = 0; run < 10; ++run) {
+            bool same = true;
+            for (int64_t i = 0; i < kElems && same; ++i) {
+                same = lhs[i] == rhs[i];
+            }
+            sink = sink + same;
+        }
+    });
+    PrintResult("operator[] loop ==", 10 * kElems, ms);
+    ms = MeasureMs([&] {
+        for (int run = 0; run < 10; ++run) {
+            sink = sink + (lhs == rhs);
+        }
+    });
+    PrintResult("Deque::operator==", 10 * kElems, ms);
+    ms = MeasureMs([&] {
+        for (int run = 0; run < 10; ++run) {
+            sink = sink + (lhs < rhs);
+        }
+    });
+    PrintResult("Deque::operator<", 10 * kElems, ms);
+    std::deque<int64_t> std_lhs(lhs.begin(), lhs.end()), std_rhs(rhs.begin(), rhs.end());
+    ms = MeasureMs([&] {
+        for (int run = 0; run < 10; ++run) {
+            sink = sink + (std_lhs == std_rhs);
+        }
+    });
+    PrintResult("std::deque::operator==", 10 * kElems, ms);
+}
+
+// Bounded FIFO: keep kInFlight elements queued, push_back one and
+// pop_front one, then read the whole window by index
+template<typename Container>
+void BenchBoundedQueue(const char* name, Container queue) {
+    const int64_t kInFlight = 1000;
+    const int64_t kOps = 20'000'000;
+    for (int64_t i = 0; i < kInFlight; ++i) {
+        queue.push_back(i);
+    }
+    double ms = MeasureMs([&] {
+        for (int64_t i = 0; i < kOps; ++i) {
+            queue.pop_front();
+            queue.push_back(i);
+        }
+        int64_t sum = 0;
+        for (int run = 0; run < 10000; ++run) {
+            for (int64_t i = 0; i < kInFlight; ++i) {
+                sum += queue[i];
+            }
+        }
+        sink = sink + sum;
+    });
+    PrintResult(name, kOps + 10000 * kInFlight, ms);
+}
+
+void BenchRing() {
+    std::printf("--- Bounded FIFO, 1000 int64_t in flight (20M push/pop + 10M reads) ---\n");
+    BenchBoundedQueue("RingDeque<int64_t, 1024>", RingDeque<int64_t, 1024>());
+    BenchBoundedQueue("RingDeque<int64_t>(1024)", RingDeque<int64_t>(1024));
+    BenchBoundedQueue("Deque<int64_t>", Deque<int64_t>());
+    BenchBoundedQueue("std::deque<int64_t>", std::deque<int64_t>());
+}
+
+// Many short-lived deques with a handful of elements each
+template<typename Container>
+void BenchSmallContainers(const char* name) {
+    const int64_t kContainers = 1'000'000;
+    const int64_t kElems = 10;
+    double ms = MeasureMs([&] {
+        for (int64_t i = 0; i < kContainers; ++i) {
+            Container d;
+            for (int64_t j = 0; j < kElems; ++j) {
+                d.push_back(j);
+            }
+            d.pop_front();
+            sink = sink + d.back();
+        }
+    });
+    PrintResult(name, kContainers, ms);
+}
+
+void BenchSmall() {
+    std::printf("--- 1M deques of 10 int64_t: create, fill, destroy ---\n");
+    std::printf("%-44s %10zu bytes\n", "sizeof(SmallDeque<int64_t, 16>)",
+                sizeof(SmallDeque<int64_t, 16>));
+    std::printf("%-44s %10zu bytes\n", "sizeof(Deque<int64_t>)", sizeof(Deque<int64_t>));
+    BenchSmallContainers<SmallDeque<int64_t, 16>>("SmallDeque<int64_t, 16>");
+    BenchSmallContainers<Deque<int64_t>>("Deque<int64_t>");
+    BenchSmallContainers<std::deque<int64_t>>("std::deque<int64_t>");
+}
+
+// Per-request structures: most deques are created and destroyed empty
+template<typename Container>
+void BenchEmptyLifetime(const char* name) {
+    const int64_t kContainers = 10'000'000;
+    double ms = MeasureMs([&] {
+        for (int64_t i = 0; i < kContainers; ++i) {
+            Container d;
+            sink = sink + int64_t(d.size());
+        }
+    });
+    PrintResult(name, kContainers, ms);
+}
+
+void BenchEmpty() {
+    std::printf("--- Create + destroy 10M empty deques ---\n");
+    BenchEmptyLifetime<Deque<int64_t>>("Deque<int64_t>");
+    BenchEmptyLifetime<std::deque<int64_t>>("std::deque<int64_t>");
+}
+
+// Deque behind a mutex: the setup WorkStealingDeque replaces
+class LockedTaskDeque {
+  public:
+    void push_back(int64_t task) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(task);
+    }
+    std::optional<int64_t> pop_back() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty()) {
+            return std::nullopt;
+        }
+        int64_t task = tasks_.back();
+        tasks_.pop_back();
+        return task;
+    }
+    std::optional<int64_t> steal() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (tasks_.empty()) {
+            return std::nullopt;
+        }
+        int64_t task = tasks_.front();
+        tasks_.pop_front();
+        return task;
+    }
+    bool empty() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return tasks_.empty();
+    }
+
+  private:
+    std::mutex mutex_;
+    Deque<int64_t> tasks_;
+};
+
+// Owner pushes tasks and pops every other one, thieves steal the rest
+template<typename TaskDeque>
+void BenchStealing(const char* name, int thieves_count) {
+    const int64_t kTasks = 4'000'000;
+    TaskDeque tasks;
+    std::atomic<bool> done{false};
+    std::atomic<int64_t> stolen{0};
+    double ms = MeasureMs([&] {
+        std::vector<std::thread> thieves;
+        for (int thief = 0; thief < thieves_count; ++thief) {
+            thieves.emplace_back([&] {
+                int64_t count = 0;
+                while (true) {
+                    bool finished = done.load(std::memory_order_acquire);
+                    if (tasks.steal()) {
+                        ++count;
+                    } else if (finished && tasks.empty()) {
+                        break;
+                    }
+                }
+                stolen += count;
+            });
+        }
+        for (int64_t i = 0; i < kTasks; ++i) {
+            tasks.push_back(i);
+            if (i % 2 == 0) {
+                tasks.pop_back();
+            }
+        }
+        while (tasks.pop_back()) {
+        }
+        done.store(true, std::memory_order_release);
+        for (std::thread& thief : thieves) {
+            thief.join();
+        }
+    });
+    char full_name[64];
+    std::snprintf(full_name, sizeof(full_name), "%s, %d thieves", name, thieves_count);
+    PrintResult(full_name, kTasks, ms);
+    sink = sink + stolen.load();
+}
+
+void BenchWorkStealing() {
+    std::printf("--- Work stealing: 4M tasks, owner pops every other one ---\n");
+    for (int thieves : {1, 2, 4}) {
+        BenchStealing<WorkStealingDeque<int64_t>>("WorkStealingDeque", thieves);
+        BenchStealing<LockedTaskDeque>("mutex + Deque", thieves);
+    }
+}
+
+// Deque behind a mutex: the pipeline hand-off SpscDeque replaces
+class LockedChannel {
+  public:
+    void push_back(int64_t item) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        items_.push_back(item);
+    }
+    std::optional<int64_t> pop_front() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (items_.empty()) {
+            return std::nullopt;
+        }
+        int64_t item = items_.front();
+        items_.pop_front();
+        return item;
+    }
+
+  private:
+    std::mutex mutex_;
+    Deque<int64_t> items_;
+};
+
+template<typename Channel>
+void BenchChannel(const char* name) {
+    const int64_t kItems = 10'000'000;
+    Channel channel;
+    double ms = MeasureMs([&] {
+        std::thread consumer([&] {
+            int64_t sum = 0;
+            for (int64_t received = 0; received < kItems; ) {
+                if (auto item = channel.pop_front()) {
+                    sum += *item;
+                    ++received;
+                }
+            }
+            sink = sink + sum;
+        });
+        for (int64_t i = 0; i < kItems; ++i) {
+            channel.push_back(i);
+        }
+        consumer.join();
+    });
+    PrintResult(name, kItems, ms);
+}
+
+void BenchSpsc() {
+    std::printf("--- One producer, one consumer: 10M int64_t ---\n");
+    BenchChannel<SpscDeque<int64_t>>("SpscDeque");
+    BenchChannel<LockedChannel>("mutex + Deque");
+}
+
+// Half of the threads push, half pop (one thread does both in turn)
+template<typename Queue>
+void BenchContended(const char* name, int threads_count) {
+    const int64_t kItems = 2'000'000;
+    Queue queue;
+    std::atomic<int64_t> received{0};
+    double ms = MeasureMs([&] {
+        if (threads_count == 1) {
+            for (int64_t i = 0; i < kItems; ++i) {
+                queue.push_back(i);
+                sink = sink + *queue.pop_front();
+            }
+            return;
+        }
+        int producers = threads_count / 2;
+        std::vector<std::thread> threads;
+        for (int producer = 0; producer < producers; ++producer) {
+            threads.emplace_back([&, producer] {
+                for (int64_t i = producer; i < kItems; i += producers) {
+                    queue.push_back(i);
+                }
+            });
+        }
+        for (int consumer = producers; consumer < threads_count; ++consumer) {
+            threads.emplace_back([&] {
+                int64_t sum = 0;
+                while (received.load(std::memory_order_relaxed) < kItems) {
+                    if (auto item = queue.pop_front()) {
+                        sum += *item;
+                        received.fetch_add(1, std::memory_order_relaxed);
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+                sink = sink + sum;
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    });
+    char full_name[64];
+    std::snprintf(full_name, sizeof(full_name), "%s, %d threads", name, threads_count);
+    PrintResult(full_name, kItems, ms);
+}
+
+void BenchConcurrent() {
+    std::printf("--- Many producers, many consumers: 2M int64_t ---\n");
+    for (int threads : {1, 2, 4, 8, 16, 32}) {
+        BenchContended<ConcurrentDeque<int64_t>>("ConcurrentDeque", threads);
+        BenchContended<LockedChannel>("mutex + Deque", threads);
+    }
+}
+
+} // namespace
+
+int main() {
+    BenchBlockSizes();
+    BenchPow2Blocks();
+    BenchAppend();
+    BenchCompactIterator();
+    BenchSegments();
+    BenchAlgorithms();
+    BenchSimd();
+    std::printf("--- Middle insert + erase, 20K std::string (40 chars) ---\n");
+    BenchMiddleInsert<Deque<std::string>>("Deque<std::string>");
+    BenchMiddleInsert<std::deque<std::string>>("std::deque<std::string>");
+    std::printf("--- Splice 100K int64_t at 1/3 of a 1M deque (x10) ---\n");
+    BenchSplice<Deque<int64_t>>("Deque::insert(pos, first, last)");
+    BenchSplice<std::deque<int64_t>>("std::deque::insert(pos, first, last)");
+    BenchReuse();
+    BenchConstruction();
+    BenchCopy();
+    BenchCompare();
+    BenchRing();
+    BenchSmall();
+    BenchEmpty();
+    BenchWorkStealing();
+    BenchSpsc();
+    BenchConcurrent();
+    return 0;
+}
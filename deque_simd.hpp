@@ -0,0 +1,438 @@
+#ifndef MYDEQUE_SIMD_H
+#define MYDEQUE_SIMD_H
+
+#include "deque.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+// Vectorized search and reduction kernels over Deque<int64_t> / Deque<double>.
+// Kernels run over every block of the deque; the vector code is written once
+// with GCC vector extensions and compiled for SSE2 (x86-64 baseline) and AVX2,
+// the AVX2 version is selected at runtime when the CPU supports it
+#if defined(__GNUC__) && defined(__x86_64__)
+#define MY_DEQUE_SIMD_X86
+#define MY_DEQUE_SIMD_INLINE __attribute__((always_inline)) inline
+#else
+#define MY_DEQUE_SIMD_INLINE inline
+#endif
+
+namespace deque_simd {
+
+enum class SimdLevel { kScalar, kSse2, kAvx2 };
+
+namespace detail {
+
+enum class CmpOp { kEqual, kLess, kGreater };
+
+template<typename T>
+struct IsKernelType {
+    static constexpr bool value = std::is_same<T, int64_t>::value ||
+                                  std::is_same<T, double>::value;
+};
+
+template<CmpOp kOp, typename T>
+inline bool Compare(T a, T b) {
+    if constexpr (kOp == CmpOp::kEqual) {
+        return a == b;
+    } else if constexpr (kOp == CmpOp::kLess) {
+        return a < b;
+    } else {
+        return a > b;
+    }
+}
+
+// Scalar kernels, also used for the tails of the vector ones
+template<typename T>
+int64_t FindScalar(const T* data, int64_t size, T val) {
+    for (int64_t i = 0; i < size; ++i) {
+        if (data[i] == val) {
+            return i;
+        }
+    }
+    return size;
+}
+template<CmpOp kOp, typename T>
+int64_t CountScalar(const T* data, int64_t size, T val) {
+    int64_t res = 0;
+    for (int64_t i = 0; i < size; ++i) {
+        res += Compare<kOp>(data[i], val);
+    }
+    return res;
+}
+// data must not be empty
+template<bool kMax, typename T>
+T MinMaxScalar(const T* data, int64_t size) {
+    T res = data[0];
+    for (int64_t i = 1; i < size; ++i) {
+        if (kMax ? res < data[i] : data[i] < res) {
+            res = data[i];
+        }
+    }
+    return res;
+}
+template<typename T>
+T SumScalar(const T* data, int64_t size) {
+    T res = 0;
+    for (int64_t i = 0; i < size; ++i) {
+        res += data[i];
+    }
+    return res;
+}
+
+#ifdef MY_DEQUE_SIMD_X86
+
+template<typename T, int kLanes>
+struct Vec {
+    typedef T type __attribute__((vector_size(sizeof(T) * kLanes)));
+    typedef int64_t mask __attribute__((vector_size(sizeof(T) * kLanes)));
+};
+
+// Vectors are passed by reference only: 32 byte vectors by value
+// change the ABI of functions compiled without AVX
+template<typename V, typename T>
+MY_DEQUE_SIMD_INLINE void LoadVec(V& res, const T* data) {
+    std::memcpy(&res, data, sizeof(V));
+}
+// acc lanes are incremented where the predicate holds (masks are -1)
+template<CmpOp kOp, typename M, typename V>
+MY_DEQUE_SIMD_INLINE void CountStep(M& acc, const V& curr, const V& bound) {
+    if constexpr (kOp == CmpOp::kEqual) {
+        acc -= curr == bound;
+    } else if constexpr (kOp == CmpOp::kLess) {
+        acc -= curr < bound;
+    } else {
+        acc -= curr > bound;
+    }
+}
+
+// Vector kernels: they are always inlined into the SSE2 / AVX2 entry points
+// below, so the same code is compiled for both instruction sets
+template<typename T, int kLanes>
+MY_DEQUE_SIMD_INLINE int64_t FindBody(const T* data, int64_t size, T val) {
+    typedef typename Vec<T, kLanes>::type V;
+    typedef typename Vec<T, kLanes>::mask M;
+    // Hits are checked once per 4 vectors, the exact position is found by the scalar loop
+    const int64_t kStep = 4 * kLanes;
+    const V needle = val - V{};
+    V curr_0;
+    V curr_1;
+    V curr_2;
+    V curr_3;
+    int64_t i = 0;
+    for (; i + kStep <= size; i += kStep) {
+        LoadVec(curr_0, data + i);
+        LoadVec(curr_1, data + i + kLanes);
+        LoadVec(curr_2, data + i + 2 * kLanes);
+        LoadVec(curr_3, data + i + 3 * kLanes);
+        M hit = (curr_0 == needle) | (curr_1 == needle) |
+                (curr_2 == needle) | (curr_3 == needle);
+        int64_t any = 0;
+        for (int lane = 0; lane < kLanes; ++lane) {
+            any |= hit[lane];
+        }
+        if (any) {
+            return i + FindScalar(data + i, kStep, val);
+        }
+    }
+    return i + FindScalar(data + i, size - i, val);
+}
+template<CmpOp kOp, typename T, int kLanes>
+MY_DEQUE_SIMD_INLINE int64_t CountBody(const T* data, int64_t size, T val) {
+    typedef typename Vec<T, kLanes>::type V;
+    typedef typename Vec<T, kLanes>::mask M;
+    const V bound = val - V{};
+    M acc_0 = {};
+    M acc_1 = {};
+    V curr_0;
+    V curr_1;
+    int64_t i = 0;
+    for (; i + 2 * kLanes <= size; i += 2 * kLanes) {
+        LoadVec(curr_0, data + i);
+        LoadVec(curr_1, data + i + kLanes);
+        CountStep<kOp>(acc_0, curr_0, bound);
+        CountStep<kOp>(acc_1, curr_1, bound);
+    }
+    acc_0 += acc_1;
+    int64_t res = CountScalar<kOp>(data + i, size - i, val);
+    for (int lane = 0; lane < kLanes; ++lane) {
+        res += acc_0[lane];
+    }
+    return res;
+}
+template<bool kMax, typename T, int kLanes>
+MY_DEQUE_SIMD_INLINE T MinMaxBody(const T* data, int64_t size) {
+    typedef typename Vec<T, kLanes>::type V;
+    if (size < kLanes) {
+        return MinMaxScalar<kMax>(data, size);
+    }
+    V acc;
+    V curr;
+    LoadVec(acc, data);
+    int64_t i = kLanes;
+    for (; i + kLanes <= size; i += kLanes) {
+        LoadVec(curr, data + i);
+        acc = (kMax ? acc < curr : curr < acc) ? curr : acc;
+    }
+    T res = acc[0];
+    for (int lane = 1; lane < kLanes; ++lane) {
+        if (kMax ? res < acc[lane] : acc[lane] < res) {
+            res = acc[lane];
+        }
+    }
+    if (i < size) {
+        T tail = MinMaxScalar<kMax>(data + i, size - i);
+        if (kMax ? res < tail : tail < res) {
+            res = tail;
+        }
+    }
+    return res;
+}
+template<typename T, int kLanes>
+MY_DEQUE_SIMD_INLINE T SumBody(const T* data, int64_t size) {
+    typedef typename Vec<T, kLanes>::type V;
+    V acc_0 = {};
+    V acc_1 = {};
+    V curr_0;
+    V curr_1;
+    int64_t i = 0;
+    for (; i + 2 * kLanes <= size; i += 2 * kLanes) {
+        LoadVec(curr_0, data + i);
+        LoadVec(curr_1, data + i + kLanes);
+        acc_0 += curr_0;
+        acc_1 += curr_1;
+    }
+    acc_0 += acc_1;
+    T res = 0;
+    for (int lane = 0; lane < kLanes; ++lane) {
+        res += acc_0[lane];
+    }
+    return res + SumScalar(data + i, size - i);
+}
+
+// Entry points per instruction set: 16 and 32 byte vectors.
+// SSE2 has no 64 bit integer compares (they come with SSE4), so the int64_t
+// compare kernels of the SSE2 level stay scalar
+template<typename T>
+int64_t FindSse2(const T* data, int64_t size, T val) {
+    if constexpr (std::is_integral<T>::value) {
+        return FindScalar(data, size, val);
+    } else {
+        return FindBody<T, 16 / sizeof(T)>(data, size, val);
+    }
+}
+template<typename T>
+__attribute__((target("avx2"))) int64_t FindAvx2(const T* data, int64_t size, T val) {
+    return FindBody<T, 32 / sizeof(T)>(data, size, val);
+}
+template<CmpOp kOp, typename T>
+int64_t CountSse2(const T* data, int64_t size, T val) {
+    if constexpr (std::is_integral<T>::value) {
+        return CountScalar<kOp>(data, size, val);
+    } else {
+        return CountBody<kOp, T, 16 / sizeof(T)>(data, size, val);
+    }
+}
+template<CmpOp kOp, typename T>
+__attribute__((target("avx2"))) int64_t CountAvx2(const T* data, int64_t size, T val) {
+    return CountBody<kOp, T, 32 / sizeof(T)>(data, size, val);
+}
+template<bool kMax, typename T>
+T MinMaxSse2(const T* data, int64_t size) {
+    if constexpr (std::is_integral<T>::value) {
+        return MinMaxScalar<kMax>(data, size);
+    } else {
+        return MinMaxBody<kMax, T, 16 / sizeof(T)>(data, size);
+    }
+}
+template<bool kMax, typename T>
+__attribute__((target("avx2"))) T MinMaxAvx2(const T* data, int64_t size) {
+    return MinMaxBody<kMax, T, 32 / sizeof(T)>(data, size);
+}
+template<typename T>
+T SumSse2(const T* data, int64_t size) {
+    return SumBody<T, 16 / sizeof(T)>(data, size);
+}
+template<typename T>
+__attribute__((target("avx2"))) T SumAvx2(const T* data, int64_t size) {
+    return SumBody<T, 32 / sizeof(T)>(data, size);
+}
+
+#endif // MY_DEQUE_SIMD_X86
+
+inline SimdLevel DetectLevel() noexcept {
+#ifdef MY_DEQUE_SIMD_X86
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") ? SimdLevel::kAvx2 : SimdLevel::kSse2;
+#else
+    return SimdLevel::kScalar;
+#endif
+}
+inline SimdLevel& ActiveLevel() noexcept {
+    static SimdLevel level = DetectLevel();
+    return level;
+}
+
+// Block kernels with runtime dispatch
+template<typename T>
+int64_t Find(const T* data, int64_t size, T val) {
+#ifdef MY_DEQUE_SIMD_X86
+    switch (ActiveLevel()) {
+        case SimdLevel::kAvx2:
+            return FindAvx2(data, size, val);
+        case SimdLevel::kSse2:
+            return FindSse2(data, size, val);
+        default:
+            break;
+    }
+#endif
+    return FindScalar(data, size, val);
+}
+template<CmpOp kOp, typename T>
+int64_t Count(const T* data, int64_t size, T val) {
+#ifdef MY_DEQUE_SIMD_X86
+    switch (ActiveLevel()) {
+        case SimdLevel::kAvx2:
+            return CountAvx2<kOp>(data, size, val);
+        case SimdLevel::kSse2:
+            return CountSse2<kOp>(data, size, val);
+        default:
+            break;
+    }
+#endif
+    return CountScalar<kOp>(data, size, val);
+}
+template<bool kMax, typename T>
+T MinMax(const T* data, int64_t size) {
+#ifdef MY_DEQUE_SIMD_X86
+    switch (ActiveLevel()) {
+        case SimdLevel::kAvx2:
+            return MinMaxAvx2<kMax>(data, size);
+        case SimdLevel::kSse2:
+            return MinMaxSse2<kMax>(data, size);
+        default:
+            break;
+    }
+#endif
+    return MinMaxScalar<kMax>(data, size);
+}
+template<typename T>
+T Sum(const T* data, int64_t size) {
+#ifdef MY_DEQUE_SIMD_X86
+    switch (ActiveLevel()) {
+        case SimdLevel::kAvx2:
+            return SumAvx2(data, size);
+        case SimdLevel::kSse2:
+            return SumSse2(data, size);
+        default:
+            break;
+    }
+#endif
+    return SumScalar(data, size);
+}
+
+template<CmpOp kOp, typename T, typename Allocator, typename BlockPolicy>
+int64_t CountIf(const Deque<T, Allocator, BlockPolicy>& deq, T val) {
+    static_assert(IsKernelType<T>::value, "deque_simd: only int64_t and double are supported");
+    int64_t res = 0;
+    for (DequeSpan<const T> segment : deq.segments()) {
+        res += Count<kOp>(segment.data(), segment.size(), val);
+    }
+    return res;
+}
+template<bool kMax, typename T, typename Allocator, typename BlockPolicy>
+T MinMaxOf(const Deque<T, Allocator, BlockPolicy>& deq) {
+    static_assert(IsKernelType<T>::value, "deque_simd: only int64_t and double are supported");
+    if (deq.empty()) {
+        throw std::runtime_error(kMax ? "deque_simd::max error: deque is empty!"
+                                      : "deque_simd::min error: deque is empty!");
+    }
+    bool first = true;
+    T res = T();
+    for (DequeSpan<const T> segment : deq.segments()) {
+        T curr = MinMax<kMax>(segment.data(), segment.size());
+        if (first || (kMax ? res < curr : curr < res)) {
+            res = curr;
+        }
+        first = false;
+    }
+    return res;
+}
+
+} // namespace detail
+
+// Instruction set used by the kernels, detected once on first use
+inline SimdLevel simd_level() noexcept {
+    return detail::ActiveLevel();
+}
+// Forces a lower level (for benchmarks and tests), levels the CPU does not
+// support are clamped. Returns the level actually set. Not thread-safe
+inline SimdLevel set_simd_level(SimdLevel level) noexcept {
+    SimdLevel supported = detail::DetectLevel();
+    detail::ActiveLevel() = level < supported ? level : supported;
+    return detail::ActiveLevel();
+}
+
+template<typename T, typename Allocator, typename BlockPolicy>
+typename Deque<T, Allocator, BlockPolicy>::const_iterator find(
+        const Deque<T, Allocator, BlockPolicy>& deq,
+        typename Deque<T, Allocator, BlockPolicy>::value_type val) {
+    static_assert(detail::IsKernelType<T>::value,
+                  "deque_simd: only int64_t and double are supported");
+    int64_t passed = 0;
+    for (DequeSpan<const T> segment : deq.segments()) {
+        int64_t index = detail::Find(segment.data(), segment.size(), val);
+        if (index != segment.size()) {
+            return deq.cbegin() + (passed + index);
+        }
+        passed += segment.size();
+    }
+    return deq.cend();
+}
+
+template<typename T, typename Allocator, typename BlockPolicy>
+int64_t count(const Deque<T, Allocator, BlockPolicy>& deq,
+              typename Deque<T, Allocator, BlockPolicy>::value_type val) {
+    return detail::CountIf<detail::CmpOp::kEqual>(deq, val);
+}
+// Number of elements < bound
+template<typename T, typename Allocator, typename BlockPolicy>
+int64_t count_less(const Deque<T, Allocator, BlockPolicy>& deq,
+                   typename Deque<T, Allocator, BlockPolicy>::value_type bound) {
+    return detail::CountIf<detail::CmpOp::kLess>(deq, bound);
+}
+// Number of elements > bound
+template<typename T, typename Allocator, typename BlockPolicy>
+int64_t count_greater(const Deque<T, Allocator, BlockPolicy>& deq,
+                      typename Deque<T, Allocator, BlockPolicy>::value_type bound) {
+    return detail::CountIf<detail::CmpOp::kGreater>(deq, bound);
+}
+
+// min and max throw on empty deque, NaNs are not supported
+template<typename T, typename Allocator, typename BlockPolicy>
+T min(const Deque<T, Allocator, BlockPolicy>& deq) {
+    return detail::MinMaxOf<false>(deq);
+}
+template<typename T, typename Allocator, typename BlockPolicy>
+T max(const Deque<T, Allocator, BlockPolicy>& deq) {
+    return detail::MinMaxOf<true>(deq);
+}
+
+// For double the summation order differs from a plain loop,
+// so the result may differ in the last bits
+template<typename T, typename Allocator, typename BlockPolicy>
+T sum(const Deque<T, Allocator, BlockPolicy>& deq) {
+    static_assert(detail::IsKernelType<T>::value,
+                  "deque_simd: only int64_t and double are supported");
+    T res = 0;
+    for (DequeSpan<const T> segment : deq.segments()) {
+        res += detail::Sum(segment.data(), segment.size());
+    }
+    return res;
+}
+
+} // namespace deque_simd
+
+#endif // MYDEQUE_SIMD_H
@@ -3,22 +3,68 @@
 #include "catch.hpp"
 
 #include "deque.hpp"
+#include "deque_simd.hpp"
+#include "work_stealing_deque.hpp"
+#include "spsc_deque.hpp"
+#include "concurrent_deque.hpp"
 
 #include <string>
 #include <vector>
 #include <deque>
+#include <functional>
+#include <sstream>
+#include <list>
+#include <iterator>
+#include <numeric>
+#include <algorithm>
+#include <cstdint>
+#include <atomic>
+#include <thread>
 
 #define DEBUG
 
-TEST_CASE("Trying 3000000 size...") {
+TEST_CASE("Copy & move") {
     SECTION("Copy & move deque") {
-        Deque<int> d(3000000);
+        Deque<int> d(30000);
         Deque<int> copy1{};
         copy1 = d;
         Deque<int> copy2{};
         copy2 = std::move(d);
         REQUIRE(copy1 == copy2);
     }
+    SECTION("Copy keeps only the live range") {
+        Deque<int> d;
+        for (int i = 0; i < 5000; ++i) {
+            d.push_back(i);
+            d.push_front(-i);
+        }
+        d.pop_front(300);
+        d.pop_back(700);
+        Deque<int> copy(d);
+        REQUIRE(copy == d);
+        REQUIRE(copy.size() == d.size());
+        copy.push_front(1);
+        copy.push_back(2);
+        REQUIRE(copy.front() == 1);
+        REQUIRE(copy[1] == d.front());
+
+        Deque<std::string> strings;
+        for (int i = 0; i < 3000; ++i) {
+            strings.push_front(std::to_string(i));
+        }
+        strings.pop_back(1000);
+        Deque<std::string> strings_copy(strings);
+        REQUIRE(strings_copy == strings);
+
+        Deque<int> small = {1, 2, 3};
+        Deque<int> small_copy(small);
+        REQUIRE(small_copy == small);
+        Deque<int> empty_d;
+        Deque<int> empty_copy(empty_d);
+        REQUIRE(empty_copy.empty());
+        empty_copy.push_back(1);
+        REQUIRE(empty_copy.back() == 1);
+    }
 }
 
 TEST_CASE("Deque_tests_21") {
@@ -379,4 +425,1405 @@ TEST_CASE("Deque_tests_21") {
             }
         }
     }
-}
\ No newline at end of file
+}
+template<typename T>
+struct CountingAllocator {
+    typedef T value_type;
+
+    int64_t* allocations;
+    int64_t* live_bytes;
+
+    explicit CountingAllocator(int64_t* counter, int64_t* bytes = nullptr) noexcept
+            : allocations(counter)
+            , live_bytes(bytes) {}
+    template<typename U>
+    CountingAllocator(const CountingAllocator<U>& other) noexcept
+            : allocations(other.allocations)
+            , live_bytes(other.live_bytes) {}
+
+    T* allocate(size_t n) {
+        ++*allocations;
+        if (live_bytes != nullptr) {
+            *live_bytes += n * sizeof(T);
+        }
+        return std::allocator<T>().allocate(n);
+    }
+    void deallocate(T* ptr, size_t n) noexcept {
+        if (live_bytes != nullptr) {
+            *live_bytes -= n * sizeof(T);
+        }
+        std::allocator<T>().deallocate(ptr, n);
+    }
+
+    template<typename U>
+    bool operator==(const CountingAllocator<U>& other) const noexcept {
+        return allocations == other.allocations;
+    }
+    template<typename U>
+    bool operator!=(const CountingAllocator<U>& other) const noexcept {
+        return !(*this == other);
+    }
+};
+
+TEST_CASE("Deque features") {
+    SECTION("Custom allocator") {
+        int64_t counter = 0;
+        CountingAllocator<int> alloc(&counter);
+        Deque<int, CountingAllocator<int>> d(alloc);
+        // Map, first block and the spare blocks array come with the first
+        // insertion
+        REQUIRE(counter == 0);
+        d.push_back(0);
+        REQUIRE(counter == 3);
+        d.pop_back();
+
+        for (int i = 0; i < 10000; ++i) {
+            d.push_back(i);
+            d.push_front(-i);
+        }
+        REQUIRE(counter > 2);
+        REQUIRE(d.front() == -9999);
+        REQUIRE(d.back() == 9999);
+
+        Deque<int, CountingAllocator<int>> copy = d;
+        REQUIRE(copy == d);
+        REQUIRE(copy.get_allocator() == alloc);
+
+        int64_t other_counter = 0;
+        Deque<int, CountingAllocator<int>> other{CountingAllocator<int>(&other_counter)};
+        other = std::move(d);
+        // Allocator is not propagated: elements are moved into own memory
+        REQUIRE(other == copy);
+        REQUIRE(other_counter > 2);
+
+        swap(copy, other);
+        REQUIRE(copy == other);
+    }
+
+    SECTION("Spare blocks cache") {
+        int64_t counter = 0;
+        Deque<int, CountingAllocator<int>> d{CountingAllocator<int>(&counter)};
+        for (int i = 0; i < 5000; ++i) {
+            d.push_back(i);
+        }
+
+        // Constant depth FIFO traffic (after warm up)
+        for (int i = 0; i < 5000; ++i) {
+            d.push_back(i);
+            d.pop_front();
+        }
+        int64_t counter_before = counter;
+        for (int i = 0; i < 100000; ++i) {
+            d.push_back(i);
+            d.pop_front();
+        }
+        REQUIRE(counter == counter_before);
+        REQUIRE(d.size() == 5000);
+        REQUIRE(d.back() == 99999);
+        REQUIRE(d.block_stats().reused > 0);
+
+        // Releasing blocks never allocates: pops and destruction of a
+        // deque that has not cached anything yet
+        {
+            int64_t fresh_counter = 0;
+            Deque<int, CountingAllocator<int>> fresh{CountingAllocator<int>(&fresh_counter)};
+            for (int64_t i = 0; i <= fresh.block_size(); ++i) {
+                fresh.push_back(int(i));
+            }
+            int64_t fresh_before = fresh_counter;
+            fresh.pop_back();
+            fresh.pop_back();
+            REQUIRE(fresh.block_stats().cached == 1);
+            fresh.clear();
+            REQUIRE(fresh_counter == fresh_before);
+        }
+        {
+            int64_t fresh_counter = 0;
+            {
+                Deque<int, CountingAllocator<int>> fresh{CountingAllocator<int>(&fresh_counter)};
+                fresh.push_back(0);
+            }
+            REQUIRE(fresh_counter == 3);
+        }
+
+        d.set_block_cache_depth(0);
+        REQUIRE(d.block_stats().cached == 0);
+        d.set_block_cache_depth(4);
+        while (!d.empty()) {
+            d.pop_back();
+        }
+        REQUIRE(d.block_stats().cached == 4);
+        d.trim();
+        REQUIRE(d.block_stats().cached == 0);
+        REQUIRE_THROWS_AS(d.set_block_cache_depth(-1), std::invalid_argument);
+    }
+
+    SECTION("Block size policy") {
+        REQUIRE(Deque<char, std::allocator<char>, DequeBlockBytes<64 * 1024>>::block_size() == 65536);
+        REQUIRE(Deque<int64_t, std::allocator<int64_t>, DequeBlockBytes<4>>::block_size() == 1);
+
+        Deque<int, std::allocator<int>, DequeBlockElems<3>> d = {1, 2, 3, 4, 5, 6, 7};
+        std::deque<int> true_d = {1, 2, 3, 4, 5, 6, 7};
+        for (int i = 0; i < 100; ++i) {
+            d.push_front(i);
+            true_d.push_front(i);
+            d.push_back(-i);
+            true_d.push_back(-i);
+        }
+        d.insert(d.begin() + 50, 1000);
+        true_d.insert(true_d.begin() + 50, 1000);
+        d.erase(d.begin() + 150);
+        true_d.erase(true_d.begin() + 150);
+        for (int i = 0; i < 30; ++i) {
+            d.pop_front();
+            true_d.pop_front();
+        }
+        REQUIRE(d == true_d);
+        REQUIRE(d.end() - d.begin() == d.size());
+        REQUIRE(*(d.begin() + 77) == true_d[77]);
+        REQUIRE(*(d.end() - 77) == *(true_d.end() - 77));
+    }
+
+    SECTION("Power of two blocks") {
+        struct Record {
+            char data[300];
+        };
+        REQUIRE(Deque<Record>::block_size() == 16);
+        REQUIRE(Deque<Record, std::allocator<Record>,
+                      DequePow2Block<DequeBlockBytes<4096>>>::block_size() == 16);
+        REQUIRE(DequeBlockMath<8>::NodeOffset(-1) == -1);
+        REQUIRE(DequeBlockMath<8>::InNodeOffset(-1) == 7);
+        REQUIRE(DequeBlockMath<6>::NodeOffset(-7) == -2);
+        REQUIRE(DequeBlockMath<6>::InNodeOffset(-7) == 5);
+
+        Deque<int, std::allocator<int>, DequePow2Block<DequeBlockElems<3>>> d;
+        REQUIRE(d.block_size() == 4);
+        std::deque<int> true_d;
+        for (int i = 0; i < 50; ++i) {
+            d.push_back(i);
+            true_d.push_back(i);
+            d.push_front(-i);
+            true_d.push_front(-i);
+        }
+        for (int64_t i = 0; i < d.size(); ++i) {
+            REQUIRE(d[i] == true_d[i]);
+            REQUIRE(*(d.end() - (i + 1)) == *(true_d.end() - (i + 1)));
+        }
+        auto it = d.begin() + 61;
+        it -= 37;
+        REQUIRE(*it == true_d[24]);
+    }
+
+    SECTION("emplace") {
+        struct Pinned {
+            Pinned(int key, std::string name) : key(key), name(std::move(name)) {}
+            Pinned(const Pinned&) = delete;
+            Pinned& operator=(const Pinned&) = delete;
+
+            int key;
+            std::string name;
+        };
+
+        Deque<Pinned, std::allocator<Pinned>, DequeBlockElems<2>> pinned;
+        for (int i = 0; i < 10; ++i) {
+            Pinned& back = pinned.emplace_back(i, std::to_string(i));
+            REQUIRE(&back == &pinned.back());
+            Pinned& front = pinned.emplace_front(-i, "front");
+            REQUIRE(&front == &pinned.front());
+        }
+        REQUIRE(pinned.size() == 20);
+        REQUIRE(pinned.back().name == "9");
+        REQUIRE(pinned.front().key == -9);
+
+        Deque<std::pair<int, std::string>> d;
+        d.emplace_back(1, "one");
+        d.emplace_back(3, "three");
+        auto it = d.emplace(d.begin() + 1, 2, "two");
+        REQUIRE(it->second == "two");
+        REQUIRE(it - d.begin() == 1);
+        it = d.emplace(d.cbegin(), 0, "zero");
+        REQUIRE(it == d.begin());
+        REQUIRE(*d.emplace(d.cend(), 4, "four") == std::make_pair(4, std::string("four")));
+        for (int64_t i = 0; i < d.size(); ++i) {
+            REQUIRE(d[i].first == i);
+        }
+    }
+
+    SECTION("append_back && append_front") {
+        std::vector<int> batch(3000);
+        for (int i = 0; i < 3000; ++i) {
+            batch[i] = i;
+        }
+
+        Deque<int> d = {-1, -2};
+        d.append_back(batch.data(), batch.data() + batch.size());
+        d.append_front(batch.begin(), batch.begin() + 2500);
+        d.append_back({7, 8, 9});
+        REQUIRE(d.size() == 5505);
+        REQUIRE(d[0] == 0);
+        REQUIRE(d[2499] == 2499);
+        REQUIRE(d[2500] == -1);
+        REQUIRE(d[2502] == 0);
+        REQUIRE(d[5501] == 2999);
+        REQUIRE(d.back() == 9);
+
+        std::vector<std::string> words = {"a", "bb", "ccc", "dddd", "eeeee"};
+        Deque<std::string, std::allocator<std::string>, DequeBlockElems<2>> ds;
+        ds.append_back(words.begin(), words.end());
+        ds.append_front(words.rbegin(), words.rend());
+        REQUIRE(ds.size() == 10);
+        REQUIRE(ds.front() == "eeeee");
+        REQUIRE(ds[4] == "a");
+        REQUIRE(ds[5] == "a");
+        REQUIRE(ds.back() == "eeeee");
+
+        // Single pass iterators
+        std::istringstream in("1 2 3 4");
+        Deque<int> from_stream;
+        from_stream.append_front(std::istream_iterator<int>(in), std::istream_iterator<int>());
+        REQUIRE(from_stream == Deque<int>{1, 2, 3, 4});
+    }
+
+    SECTION("Bulk pop && consume_front") {
+        int64_t counter = 0;
+        Deque<std::string, CountingAllocator<std::string>, DequeBlockElems<4>> d{
+                            CountingAllocator<std::string>(&counter)};
+        for (int i = 0; i < 100; ++i) {
+            d.push_back(std::to_string(i));
+        }
+
+        d.pop_front(10);
+        REQUIRE(d.front() == "10");
+        d.pop_back(15);
+        REQUIRE(d.back() == "84");
+        REQUIRE(d.size() == 75);
+
+        std::vector<std::string> out;
+        d.consume_front(30, std::back_inserter(out));
+        REQUIRE(out.size() == 30);
+        REQUIRE(out.front() == "10");
+        REQUIRE(out.back() == "39");
+        REQUIRE(d.front() == "40");
+        REQUIRE(d.size() == 45);
+
+        REQUIRE_THROWS_AS(d.pop_front(46), std::out_of_range);
+        REQUIRE_THROWS_AS(d.pop_back(-1), std::out_of_range);
+
+        d.pop_front(0);
+        d.pop_back(45);
+        REQUIRE(d.empty());
+        d.push_front("again");
+        REQUIRE(d.front() == "again");
+        REQUIRE(d.back() == "again");
+
+        Deque<int> ints(5000, 1);
+        ints.erase(ints.begin(), ints.end());
+        REQUIRE(ints.empty());
+        ints.push_back(2);
+        REQUIRE(ints == Deque<int>{2});
+    }
+
+    SECTION("shrink_to_fit") {
+        int64_t counter = 0;
+        int64_t live_bytes = 0;
+        Deque<int, CountingAllocator<int>> d{CountingAllocator<int>(&counter, &live_bytes)};
+        d.push_back(0);
+        d.pop_back();
+        const int64_t empty_bytes = live_bytes;
+
+        for (int i = 0; i < 1'000'000; ++i) {
+            d.push_back(i);
+        }
+        int64_t peak_bytes = live_bytes;
+        d.pop_front(999'990);
+        REQUIRE(live_bytes < peak_bytes);
+        // Blocks are freed, but the map stays as large as at the peak
+        REQUIRE(live_bytes > empty_bytes + int64_t(d.block_size() * sizeof(int)));
+
+        d.shrink_to_fit();
+        REQUIRE(live_bytes <= empty_bytes + int64_t(d.block_size() * sizeof(int)));
+        REQUIRE(d.block_stats().cached == 0);
+        REQUIRE(d.size() == 10);
+        REQUIRE(d.front() == 999'990);
+        REQUIRE(d.back() == 999'999);
+
+        d.push_front(1);
+        d.push_back(2);
+        REQUIRE(d.front() == 1);
+        REQUIRE(d.back() == 2);
+    }
+
+    SECTION("reserve_front && reserve_back") {
+        int64_t counter = 0;
+        Deque<int, CountingAllocator<int>, DequeBlockElems<16>> d{CountingAllocator<int>(&counter)};
+        REQUIRE(d.capacity_back() == 0);
+        REQUIRE(d.capacity_front() == 0);
+
+        d.reserve_back(1000);
+        d.reserve_front(500);
+        REQUIRE(d.capacity_back() >= 1000);
+        REQUIRE(d.capacity_front() >= 500);
+
+        int64_t counter_before = counter;
+        for (int i = 0; i < 1000; ++i) {
+            d.push_back(i);
+        }
+        for (int i = 0; i < 500; ++i) {
+            d.push_front(-i);
+        }
+        REQUIRE(counter == counter_before);
+        REQUIRE(d.size() == 1500);
+        REQUIRE(d.front() == -499);
+        REQUIRE(d.back() == 999);
+
+        // Popped blocks stay reserved while there is a reserve behind them,
+        // up to the size last asked for
+        d.reserve_back(100);
+        int64_t capacity = d.capacity_back();
+        d.resize(d.size() + 64);
+        d.pop_back(64);
+        REQUIRE(d.capacity_back() == capacity);
+        d.pop_back(64);
+        REQUIRE(d.capacity_back() < capacity + d.block_size());
+
+        // Map reallocation keeps reserved blocks
+        capacity = d.capacity_back();
+        d.reserve_front(100'000);
+        REQUIRE(d.capacity_back() == capacity);
+        for (int i = 0; i < 100'000; ++i) {
+            d.push_front(i);
+        }
+        REQUIRE(d.front() == 99'999);
+        REQUIRE(d.back() == 935);
+
+        d.shrink_to_fit();
+        REQUIRE(d.capacity_front() < 16);
+        REQUIRE(d.capacity_back() < 16);
+        d.append_back({1, 2, 3});
+        REQUIRE(d.back() == 3);
+
+        // Constant depth FIFO traffic behind a front reserve: blocks drained
+        // at the front don't pile up in it
+        int64_t fifo_counter = 0;
+        Deque<int, CountingAllocator<int>, DequeBlockElems<16>> fifo{
+                CountingAllocator<int>(&fifo_counter)};
+        fifo.reserve_front(5000);
+        const int64_t front_capacity = fifo.capacity_front();
+        for (int i = 0; i < 1000; ++i) {
+            fifo.push_back(i);
+        }
+        for (int i = 0; i < 1000; ++i) {
+            fifo.push_back(i);
+            fifo.pop_front();
+        }
+        int64_t fifo_counter_before = fifo_counter;
+        for (int i = 0; i < 100'000; ++i) {
+            fifo.push_back(i);
+            fifo.pop_front();
+        }
+        REQUIRE(fifo_counter == fifo_counter_before);
+        REQUIRE(fifo.capacity_front() < front_capacity + fifo.block_size());
+        REQUIRE(fifo.size() == 1000);
+        REQUIRE(fifo.front() == 99'000);
+    }
+
+    SECTION("Compact iterators") {
+        static_assert(sizeof(Deque<int>::compact_iterator) == 16, "");
+        static_assert(std::is_trivially_copyable<Deque<int>::iterator>::value, "");
+
+        Deque<int, std::allocator<int>, DequeBlockElems<5>> d;
+        std::deque<int> true_d;
+        for (int i = 0; i < 200; ++i) {
+            int val = (i * 7919) % 211;
+            d.push_back(val);
+            true_d.push_back(val);
+        }
+        d.pop_front(3);
+        true_d.erase(true_d.begin(), true_d.begin() + 3);
+
+        auto it = d.compact_begin();
+        REQUIRE(d.compact_end() - it == d.size());
+        REQUIRE(*(it + 17) == true_d[17]);
+        REQUIRE((d.compact_end() - 1)[0] == true_d.back());
+        auto prev = it++;
+        REQUIRE(prev == d.compact_begin());
+        REQUIRE(*it == true_d[1]);
+        it += 50;
+        it -= 49;
+        REQUIRE(*it == true_d[2]);
+
+        std::sort(d.compact_begin(), d.compact_end());
+        std::sort(true_d.begin(), true_d.end());
+        REQUIRE(d == true_d);
+
+        std::sort(d.begin(), d.end(), std::greater<int>());
+        std::sort(true_d.begin(), true_d.end(), std::greater<int>());
+        REQUIRE(d == true_d);
+
+        const auto& cd = d;
+        int64_t counter = 0;
+        for (auto cit = cd.compact_begin(); cit != cd.compact_end(); ++cit) {
+            REQUIRE(*cit == true_d[counter++]);
+        }
+        REQUIRE(counter == d.size());
+    }
+
+    SECTION("Segments") {
+        Deque<int, std::allocator<int>, DequeBlockElems<8>> d;
+        for (int i = 0; i < 100; ++i) {
+            d.push_back(i);
+        }
+        d.pop_front(5);
+
+        int64_t sum = 0;
+        int64_t segments_count = 0;
+        d.for_each_segment([&](DequeSpan<int> segment) {
+            for (int& elem : segment) {
+                elem *= 2;
+            }
+            ++segments_count;
+        });
+        const auto& cd = d;
+        cd.for_each_segment([&](DequeSpan<const int> segment) {
+            for (int elem : segment) {
+                sum += elem;
+            }
+        });
+        REQUIRE(sum == 2 * (99 * 100 / 2 - 10));
+        // Blocks: [5, 8), 11 full blocks, [96, 100)
+        REQUIRE(segments_count == 13);
+
+        int64_t expected = 10;
+        int64_t range_count = 0;
+        for (DequeSpan<const int> segment : cd.segments()) {
+            REQUIRE(segment.size() > 0);
+            REQUIRE(segment[0] == expected);
+            expected += 2 * segment.size();
+            ++range_count;
+        }
+        REQUIRE(range_count == segments_count);
+
+        // Empty tail block is skipped
+        d.pop_back(4);
+        range_count = 0;
+        for (auto segment : d.segments()) {
+            REQUIRE(!segment.empty());
+            ++range_count;
+        }
+        REQUIRE(range_count == 12);
+
+        Deque<int> empty_d;
+        REQUIRE(empty_d.segments().begin() == empty_d.segments().end());
+        empty_d.for_each_segment([](DequeSpan<int>) { REQUIRE(false); });
+    }
+
+    SECTION("Segmented algorithms") {
+        Deque<int> d;
+        std::deque<int> expected;
+        for (int i = 0; i < 1000; ++i) {
+            d.push_back(i);
+            expected.push_back(i);
+        }
+        for (int i = 0; i < 37; ++i) {
+            d.push_front(-i);
+            expected.push_front(-i);
+        }
+        REQUIRE(deque_algo::equal(d.begin(), d.end(), expected.begin()));
+        REQUIRE(deque_algo::count(d.begin(), d.end(), 0) == 2);
+        REQUIRE(deque_algo::find(d.begin(), d.end(), 500) - d.begin() == 537);
+        REQUIRE(deque_algo::find(d.begin(), d.end(), 5000) == d.end());
+        REQUIRE(deque_algo::accumulate(d.cbegin(), d.cend(), int64_t(0)) ==
+                std::accumulate(expected.begin(), expected.end(), int64_t(0)));
+
+        // Overlapping shifts inside one deque
+        deque_algo::copy(d.begin() + 100, d.end(), d.begin() + 3);
+        std::copy(expected.begin() + 100, expected.end(), expected.begin() + 3);
+        REQUIRE(deque_algo::equal(d.cbegin(), d.cend(), expected.begin()));
+        deque_algo::copy_backward(d.begin() + 1, d.begin() + 900, d.end() - 5);
+        std::copy_backward(expected.begin() + 1, expected.begin() + 900, expected.end() - 5);
+        REQUIRE(deque_algo::equal(d.cbegin(), d.cend(), expected.begin()));
+
+        // Between deques with different block sizes
+        Deque<int, std::allocator<int>, DequeBlockElems<7>> other(d.size());
+        REQUIRE(deque_algo::copy(d.cbegin(), d.cend(), other.begin()) == other.end());
+        REQUIRE(deque_algo::equal(d.begin(), d.end(), other.cbegin()));
+        other[500] = -1;
+        REQUIRE(!deque_algo::equal(other.begin(), other.end(), d.begin()));
+
+        deque_algo::fill(d.begin() + 10, d.end() - 10, 7);
+        std::fill(expected.begin() + 10, expected.end() - 10, 7);
+        REQUIRE(deque_algo::equal(d.cbegin(), d.cend(), expected.begin()));
+
+        std::vector<int> out(d.size());
+        REQUIRE(deque_algo::copy(d.begin(), d.end(), out.begin()) == out.end());
+        REQUIRE(std::equal(out.begin(), out.end(), expected.begin()));
+
+        // Non trivially copyable elements
+        Deque<std::string> strings;
+        for (int i = 0; i < 100; ++i) {
+            strings.push_back(std::to_string(i));
+        }
+        Deque<std::string> moved;
+        for (int i = 0; i < 100; ++i) {
+            moved.push_back("");
+        }
+        deque_algo::move(strings.begin(), strings.end(), moved.begin());
+        REQUIRE(moved[42] == "42");
+        deque_algo::move_backward(moved.begin(), moved.end() - 1, moved.end());
+        REQUIRE(moved[43] == "42");
+        REQUIRE(moved.back() == "98");
+    }
+
+    SECTION("SIMD kernels") {
+        Deque<int64_t> ints;
+        Deque<double> doubles;
+        std::vector<int64_t> expected;
+        for (int64_t i = 0; i < 3000; ++i) {
+            // Values around zero and close to the int64_t limits
+            int64_t val = (i * 7919) % 1001 - 500;
+            if (i % 97 == 0) {
+                val = (i % 2 ? INT64_MAX - i : INT64_MIN + i);
+            }
+            if (i % 3 == 0) {
+                ints.push_front(val);
+                doubles.push_front(double(i % 1001 - 500));
+                expected.insert(expected.begin(), val);
+            } else {
+                ints.push_back(val);
+                doubles.push_back(double(i % 1001 - 500));
+                expected.push_back(val);
+            }
+        }
+        std::vector<double> expected_doubles(doubles.begin(), doubles.end());
+        Deque<int64_t> window;
+        for (double elem : doubles) {
+            window.push_back(int64_t(elem) * 1000000007);
+        }
+
+        for (auto level : {deque_simd::SimdLevel::kScalar, deque_simd::SimdLevel::kSse2,
+                           deque_simd::SimdLevel::kAvx2}) {
+            deque_simd::set_simd_level(level);
+
+            for (int64_t val : {int64_t(-500), int64_t(0), int64_t(499), INT64_MIN + 97,
+                                int64_t(12345)}) {
+                auto it = std::find(expected.begin(), expected.end(), val);
+                REQUIRE(deque_simd::find(ints, val) - ints.cbegin() ==
+                        it - expected.begin());
+                REQUIRE(deque_simd::count(ints, val) ==
+                        std::count(expected.begin(), expected.end(), val));
+                REQUIRE(deque_simd::count_less(ints, val) ==
+                        std::count_if(expected.begin(), expected.end(),
+                                      [val](int64_t elem) { return elem < val; }));
+                REQUIRE(deque_simd::count_greater(ints, val) ==
+                        std::count_if(expected.begin(), expected.end(),
+                                      [val](int64_t elem) { return elem > val; }));
+            }
+            REQUIRE(deque_simd::min(ints) ==
+                    *std::min_element(expected.begin(), expected.end()));
+            REQUIRE(deque_simd::max(ints) ==
+                    *std::max_element(expected.begin(), expected.end()));
+            REQUIRE(deque_simd::sum(window) == std::accumulate(window.begin(), window.end(),
+                                                               int64_t(0)));
+            REQUIRE(deque_simd::find(doubles, 7.0) - doubles.cbegin() ==
+                    std::find(expected_doubles.begin(), expected_doubles.end(), 7.0) -
+                            expected_doubles.begin());
+            REQUIRE(deque_simd::find(doubles, 0.5) == doubles.cend());
+            REQUIRE(deque_simd::count(doubles, -3.0) == 3);
+            REQUIRE(deque_simd::count_less(doubles, 0.0) ==
+                    std::count_if(expected_doubles.begin(), expected_doubles.end(),
+                                  [](double elem) { return elem < 0.0; }));
+            REQUIRE(deque_simd::count_greater(doubles, 100.0) ==
+                    std::count_if(expected_doubles.begin(), expected_doubles.end(),
+                                  [](double elem) { return elem > 100.0; }));
+            REQUIRE(deque_simd::min(doubles) == -500.0);
+            REQUIRE(deque_simd::max(doubles) == 500.0);
+            // Integer values: exact in any summation order
+            REQUIRE(deque_simd::sum(doubles) ==
+                    std::accumulate(expected_doubles.begin(), expected_doubles.end(), 0.0));
+        }
+        deque_simd::set_simd_level(deque_simd::SimdLevel::kAvx2);
+
+        Deque<double> empty_d;
+        REQUIRE(deque_simd::find(empty_d, 1.0) == empty_d.cend());
+        REQUIRE(deque_simd::sum(empty_d) == 0.0);
+        REQUIRE_THROWS_AS(deque_simd::min(empty_d), std::runtime_error);
+    }
+
+    SECTION("Move-based insert && erase") {
+        struct CopyCounter {
+            int value = 0;
+            int64_t* copies = nullptr;
+
+            CopyCounter(int val, int64_t* counter) : value(val), copies(counter) {}
+            CopyCounter(const CopyCounter& other) : value(other.value), copies(other.copies) {
+                ++*copies;
+            }
+            CopyCounter(CopyCounter&& other) noexcept = default;
+            CopyCounter& operator=(const CopyCounter& other) {
+                value = other.value;
+                copies = other.copies;
+                ++*copies;
+                return *this;
+            }
+            CopyCounter& operator=(CopyCounter&& other) noexcept = default;
+        };
+        int64_t copies = 0;
+        Deque<CopyCounter> d;
+        for (int i = 0; i < 2000; ++i) {
+            d.push_back(CopyCounter(i, &copies));
+        }
+        d.insert(d.begin() + 300, CopyCounter(-1, &copies));
+        d.insert(d.end() - 300, CopyCounter(-2, &copies));
+        CopyCounter val(-3, &copies);
+        d.insert(d.begin() + 1000, val);
+        d.erase(d.begin() + 10);
+        d.erase(d.end() - 10);
+        d.erase(d.begin() + 500, d.begin() + 600);
+        // Only the explicit lvalue insert copies
+        REQUIRE(copies == 1);
+        std::deque<int> values;
+        for (int i = 0; i < 2000; ++i) {
+            values.push_back(i);
+        }
+        values.insert(values.begin() + 300, -1);
+        values.insert(values.end() - 300, -2);
+        values.insert(values.begin() + 1000, -3);
+        values.erase(values.begin() + 10);
+        values.erase(values.end() - 10);
+        values.erase(values.begin() + 500, values.begin() + 600);
+        REQUIRE(d.size() == int64_t(values.size()));
+        for (int64_t i = 0; i < d.size(); ++i) {
+            REQUIRE(d[i].value == values[i]);
+        }
+
+        // Inserting an element of the deque itself
+        Deque<std::string> strings;
+        std::deque<std::string> expected;
+        for (int i = 0; i < 100; ++i) {
+            strings.push_back(std::to_string(i));
+            expected.push_back(std::to_string(i));
+        }
+        strings.insert(strings.begin() + 10, strings[50]);
+        expected.insert(expected.begin() + 10, expected[50]);
+        strings.insert(strings.begin() + 90, strings.back());
+        expected.insert(expected.begin() + 90, expected.back());
+        REQUIRE(std::equal(strings.begin(), strings.end(), expected.begin(), expected.end()));
+
+        // List longer and shorter than the shifted part, both sides
+        for (int pos : {1, 2, 5, 50, 97, 99, 100}) {
+            strings.insert(strings.begin() + pos, {"a", "b", "c", "d", "e"});
+            expected.insert(expected.begin() + pos, {"a", "b", "c", "d", "e"});
+            REQUIRE(std::equal(strings.begin(), strings.end(), expected.begin(),
+                               expected.end()));
+        }
+        strings.insert(strings.cbegin() + 3, {});
+        REQUIRE(strings.size() == int64_t(expected.size()));
+
+        // Empty range erase moves nothing onto itself, full range clears
+        Deque<std::string> long_strings;
+        std::vector<std::string> long_expected;
+        for (int i = 0; i < 10; ++i) {
+            long_strings.push_back(std::string(40, char('a' + i)));
+            long_expected.push_back(std::string(40, char('a' + i)));
+        }
+        long_strings.erase(long_strings.begin() + 3, long_strings.begin() + 3);
+        long_strings.erase(long_strings.begin() + 8, long_strings.begin() + 8);
+        long_strings.erase(long_strings.end(), long_strings.end());
+        REQUIRE(std::equal(long_strings.begin(), long_strings.end(), long_expected.begin(),
+                           long_expected.end()));
+        long_strings.erase(long_strings.begin(), long_strings.end());
+        REQUIRE(long_strings.empty());
+        long_strings.push_back("x");
+        REQUIRE(long_strings.front() == "x");
+    }
+
+    SECTION("Range && fill insert") {
+        Deque<int> d;
+        std::deque<int> expected;
+        for (int i = 0; i < 3000; ++i) {
+            d.push_back(i);
+            expected.push_back(i);
+        }
+        std::vector<int> source(2500);
+        for (int i = 0; i < 2500; ++i) {
+            source[i] = -i;
+        }
+        // Gap shorter and longer than the shifted side, across blocks
+        for (int pos : {0, 1, 700, 1500, 2999, 3000}) {
+            for (int len : {0, 1, 5, 1100, 2500}) {
+                Deque<int> curr(d);
+                std::deque<int> curr_expected(expected);
+                auto it = curr.insert(curr.begin() + pos, source.begin(), source.begin() + len);
+                curr_expected.insert(curr_expected.begin() + pos, source.begin(),
+                                     source.begin() + len);
+                REQUIRE(it - curr.begin() == pos);
+                REQUIRE(curr.size() == int64_t(curr_expected.size()));
+                REQUIRE(std::equal(curr.begin(), curr.end(), curr_expected.begin()));
+            }
+        }
+
+        d.insert(d.cbegin() + 1000, int64_t(2000), 7);
+        expected.insert(expected.begin() + 1000, 2000, 7);
+        d.insert(d.begin() + 10, int64_t(3), 8);
+        expected.insert(expected.begin() + 10, 3, 8);
+        REQUIRE(std::equal(d.begin(), d.end(), expected.begin(), expected.end()));
+
+        // Bidirectional and input ranges
+        std::list<int> from_list = {1, 2, 3, 4};
+        d.insert(d.begin() + 2, from_list.begin(), from_list.end());
+        expected.insert(expected.begin() + 2, from_list.begin(), from_list.end());
+        std::istringstream stream("5 6 7 8 9");
+        d.insert(d.end() - 3, std::istream_iterator<int>(stream), std::istream_iterator<int>());
+        expected.insert(expected.end() - 3, {5, 6, 7, 8, 9});
+        REQUIRE(std::equal(d.begin(), d.end(), expected.begin(), expected.end()));
+
+        Deque<std::string> strings = {"x", "y", "z"};
+        strings.insert(strings.begin() + 1, int64_t(4), strings[2]);
+        std::vector<std::string> words = {"a", "b"};
+        strings.insert(strings.begin() + 6, std::make_move_iterator(words.begin()),
+                       std::make_move_iterator(words.end()));
+        std::vector<std::string> strings_expected = {"x", "z", "z", "z", "z", "y",
+                                                     "a", "b", "z"};
+        REQUIRE(std::equal(strings.begin(), strings.end(), strings_expected.begin(),
+                           strings_expected.end()));
+    }
+
+    SECTION("resize, assign && clear") {
+        Deque<std::string> strings;
+        strings.resize(3000);
+        REQUIRE(strings.size() == 3000);
+        REQUIRE(strings[2999].empty());
+        strings.resize(5000, "x");
+        REQUIRE(strings[2999].empty());
+        REQUIRE(strings[3000] == "x");
+        REQUIRE(strings.back() == "x");
+        strings.resize(10);
+        REQUIRE(strings.size() == 10);
+        strings.resize(0);
+        REQUIRE(strings.empty());
+
+        Deque<int> d;
+        d.resize(5000);
+        REQUIRE(std::count(d.begin(), d.end(), 0) == 5000);
+        d.resize(6000, 3);
+        REQUIRE(d[4999] == 0);
+        REQUIRE(d[5000] == 3);
+
+        std::vector<int> source = {1, 2, 3, 4, 5};
+        d.assign(source.begin(), source.end());
+        REQUIRE(std::equal(d.begin(), d.end(), source.begin(), source.end()));
+        std::istringstream stream("9 8 7 6 5 4 3 2");
+        d.assign(std::istream_iterator<int>(stream), std::istream_iterator<int>());
+        REQUIRE(d.size() == 8);
+        REQUIRE(d.back() == 2);
+        d.assign(int64_t(4000), 11);
+        REQUIRE(d.size() == 4000);
+        REQUIRE(std::count(d.begin(), d.end(), 11) == 4000);
+        d = {1, 2};
+        REQUIRE(d.size() == 2);
+        REQUIRE(d[1] == 2);
+        strings.assign({"a", "b", "c"});
+        REQUIRE(strings[2] == "c");
+        strings.assign(int64_t(2), strings[0]);
+        REQUIRE(strings.size() == 2);
+        REQUIRE(strings[1] == "a");
+
+        // clear keeps one warm block
+        for (int i = 0; i < 10000; ++i) {
+            d.push_back(i);
+        }
+        d.clear();
+        REQUIRE(d.empty());
+        REQUIRE(d.begin() == d.end());
+        int64_t allocated = d.block_stats().allocated;
+        for (int run = 0; run < 100; ++run) {
+            for (int i = 0; i < 100; ++i) {
+                d.push_back(i);
+                d.push_front(-i);
+            }
+            REQUIRE(d.size() == 200);
+            REQUIRE(d.front() == -99);
+            d.clear();
+        }
+        REQUIRE(d.block_stats().allocated == allocated);
+        strings.clear();
+        strings.push_back("again");
+        REQUIRE(strings.front() == "again");
+    }
+
+    SECTION("Sized constructors") {
+        Deque<int> zeros(5000);
+        REQUIRE(std::count(zeros.begin(), zeros.end(), 0) == 5000);
+        Deque<std::string> strings(3000);
+        REQUIRE(strings.size() == 3000);
+        REQUIRE(std::all_of(strings.begin(), strings.end(),
+                            [](const std::string& str) { return str.empty(); }));
+        Deque<std::string> filled(3000, "abc");
+        REQUIRE(std::count(filled.begin(), filled.end(), "abc") == 3000);
+
+        Deque<int64_t> raw(100000, deque_default_init);
+        REQUIRE(raw.size() == 100000);
+        raw[99999] = 1;
+        REQUIRE(raw.back() == 1);
+        Deque<std::string> default_strings(10, deque_default_init);
+        REQUIRE(default_strings[9].empty());
+
+        // Failed construction releases everything (checked by sanitizers)
+        struct ThrowingCopy {
+            int* copies = nullptr;
+            explicit ThrowingCopy(int* counter) : copies(counter) {}
+            ThrowingCopy(const ThrowingCopy& other) : copies(other.copies) {
+                if (++*copies == 2000) {
+                    throw std::runtime_error("copy");
+                }
+            }
+        };
+        int copies = 0;
+        ThrowingCopy proto(&copies);
+        REQUIRE_NOTHROW(Deque<ThrowingCopy>(1000, proto));
+        REQUIRE_THROWS_AS(Deque<ThrowingCopy>(3000, proto), std::runtime_error);
+    }
+
+    SECTION("Block-level comparison") {
+        // Different block offsets on both sides
+        Deque<int> lhs, rhs;
+        std::deque<int> lhs_std, rhs_std;
+        for (int i = 0; i < 5000; ++i) {
+            lhs.push_back(i);
+            lhs_std.push_back(i);
+        }
+        for (int i = 4999; i >= 0; --i) {
+            rhs.push_front(i);
+            rhs_std.push_front(i);
+        }
+        REQUIRE(lhs == rhs);
+        REQUIRE_FALSE(lhs != rhs);
+        REQUIRE_FALSE(lhs < rhs);
+        REQUIRE(lhs <= rhs);
+        REQUIRE(lhs >= rhs);
+
+        rhs[3333] = -1;
+        rhs_std[3333] = -1;
+        REQUIRE(lhs != rhs);
+        REQUIRE((lhs < rhs) == (lhs_std < rhs_std));
+        REQUIRE((rhs < lhs) == (rhs_std < lhs_std));
+        REQUIRE(rhs < lhs);
+        REQUIRE(lhs > rhs);
+
+        rhs[3333] = 3333;
+        rhs.pop_back();
+        REQUIRE(lhs != rhs);
+        REQUIRE(rhs < lhs);
+        REQUIRE_FALSE(lhs < rhs);
+        REQUIRE(Deque<int>() < rhs);
+        REQUIRE(Deque<int>() == Deque<int>());
+
+        auto diff = deque_algo::mismatch(lhs.cbegin(), lhs.cend() - 1, rhs.cbegin());
+        REQUIRE(diff.first == lhs.cend() - 1);
+        rhs[4000] = 0;
+        diff = deque_algo::mismatch(lhs.cbegin(), lhs.cend() - 1, rhs.cbegin());
+        REQUIRE(diff.first - lhs.cbegin() == 4000);
+        REQUIRE(diff.second - rhs.cbegin() == 4000);
+
+        // Element-wise path
+        Deque<std::string> words = {"a", "b", "c"};
+        Deque<std::string> other = {"a", "b", "d"};
+        REQUIRE(words != other);
+        REQUIRE(words < other);
+        other[2] = "c";
+        REQUIRE(words == other);
+        Deque<double> zeros = {0.0, 1.0};
+        Deque<double> neg_zeros = {-0.0, 1.0};
+        REQUIRE(zeros == neg_zeros);
+        REQUIRE_FALSE(zeros < neg_zeros);
+
+        // Same operator set on the other containers
+        RingDeque<int, 8> ring_lhs{1, 2, 3};
+        RingDeque<int, 8> ring_rhs{1, 2, 4};
+        REQUIRE(ring_lhs < ring_rhs);
+        REQUIRE(ring_rhs > ring_lhs);
+        REQUIRE(ring_lhs <= ring_rhs);
+        REQUIRE(ring_rhs >= ring_lhs);
+        REQUIRE_FALSE(ring_lhs > ring_rhs);
+        REQUIRE_FALSE(ring_lhs >= ring_rhs);
+        REQUIRE(ring_lhs <= ring_lhs);
+        REQUIRE(ring_lhs >= ring_lhs);
+        SmallDeque<int, 2> small_lhs{1, 2, 3};
+        SmallDeque<int, 2> small_rhs{1, 2};
+        REQUIRE(small_rhs < small_lhs);
+        REQUIRE(small_lhs > small_rhs);
+        REQUIRE(small_rhs <= small_lhs);
+        REQUIRE(small_lhs >= small_rhs);
+        REQUIRE_FALSE(small_rhs > small_lhs);
+        REQUIRE_FALSE(small_rhs >= small_lhs);
+        REQUIRE(small_lhs <= small_lhs);
+        REQUIRE(small_lhs >= small_lhs);
+    }
+
+    SECTION("Ring deque") {
+        RingDeque<int, 100> ring;
+        std::deque<int> std_ring;
+        REQUIRE(ring.capacity() == 100);
+        REQUIRE(ring.empty());
+        // Random ops keep head wrapping around the 128 slots
+        for (int i = 0; i < 100000; ++i) {
+            int op = std::rand() % 4;
+            if (op == 0 && !ring.full()) {
+                ring.push_back(i);
+                std_ring.push_back(i);
+            } else if (op == 1 && !ring.full()) {
+                ring.push_front(i);
+                std_ring.push_front(i);
+            } else if (op == 2 && !ring.empty()) {
+                ring.pop_back();
+                std_ring.pop_back();
+            } else if (op == 3 && !ring.empty()) {
+                ring.pop_front();
+                std_ring.pop_front();
+            }
+            REQUIRE(ring.size() == int64_t(std_ring.size()));
+            if (!ring.empty()) {
+                REQUIRE(ring.front() == std_ring.front());
+                REQUIRE(ring.back() == std_ring.back());
+            }
+        }
+        REQUIRE(std::equal(ring.begin(), ring.end(), std_ring.begin(), std_ring.end()));
+        REQUIRE(std::equal(ring.rbegin(), ring.rend(), std_ring.rbegin(), std_ring.rend()));
+
+        ring.clear();
+        for (int i = 0; i < 100; ++i) {
+            ring.push_front(i);
+        }
+        REQUIRE(ring.full());
+        REQUIRE_THROWS_AS(ring.push_back(0), std::length_error);
+        REQUIRE_THROWS_AS(ring.emplace_front(0), std::length_error);
+        std::sort(ring.begin(), ring.end());
+        for (int i = 0; i < 100; ++i) {
+            REQUIRE(ring[i] == i);
+        }
+        REQUIRE(ring.end() - ring.begin() == 100);
+        REQUIRE_THROWS_AS(ring.at(100), std::out_of_range);
+        REQUIRE_THROWS_AS((RingDeque<int, 4>().pop_front()), std::runtime_error);
+
+        // Runtime capacity, non-trivial elements
+        RingDeque<std::string> words(1000);
+        REQUIRE(words.capacity() == 1000);
+        for (int i = 0; i < 1000; ++i) {
+            words.push_back(std::to_string(i));
+        }
+        REQUIRE_THROWS_AS(words.push_front("x"), std::length_error);
+        for (int i = 0; i < 500; ++i) {
+            words.pop_front();
+            words.emplace_back(40, 'a');
+        }
+        RingDeque<std::string> copy(words);
+        REQUIRE(copy == words);
+        RingDeque<std::string> moved(std::move(copy));
+        REQUIRE(moved == words);
+        REQUIRE(copy.empty());
+        REQUIRE(copy.capacity() == 0);
+        REQUIRE(moved.front() == "500");
+        REQUIRE(moved.back() == std::string(40, 'a'));
+        copy = moved;
+        copy.pop_back();
+        REQUIRE(copy < moved);
+        swap(copy, moved);
+        REQUIRE(copy.size() == 1000);
+        REQUIRE(moved.size() == 999);
+
+        RingDeque<std::string, 8> inline_words = {"a", "b", "c"};
+        RingDeque<std::string, 8> inline_copy = inline_words;
+        inline_copy.push_front("z");
+        inline_words = std::move(inline_copy);
+        REQUIRE(inline_words.size() == 4);
+        REQUIRE(inline_words.front() == "z");
+        REQUIRE(inline_copy.empty());
+        REQUIRE_THROWS_AS((RingDeque<int, 2>{1, 2, 3}), std::length_error);
+        RingDeque<int> no_slots;
+        REQUIRE_THROWS_AS(no_slots.push_back(0), std::length_error);
+
+        // A throwing element move leaves nothing constructed behind
+        // (leaks are checked by sanitizers)
+        struct ThrowingMove {
+            std::string value;
+            int* moves = nullptr;
+            ThrowingMove(std::string val, int* counter) : value(std::move(val)), moves(counter) {}
+            ThrowingMove(ThrowingMove&& other) : value(other.value), moves(other.moves) {
+                if (++*moves == 3) {
+                    throw std::runtime_error("move");
+                }
+            }
+        };
+        int moves = 0;
+        RingDeque<ThrowingMove, 8> throwers;
+        for (int i = 0; i < 5; ++i) {
+            throwers.emplace_back(std::string(40, 'a'), &moves);
+        }
+        REQUIRE_THROWS_AS((RingDeque<ThrowingMove, 8>(std::move(throwers))), std::runtime_error);
+        REQUIRE(throwers.size() == 5);
+    }
+
+    SECTION("Small deque") {
+        SmallDeque<int, 16> small;
+        std::deque<int> std_small;
+        REQUIRE(small.is_inline());
+        for (int i = 0; i < 16; ++i) {
+            if (i % 2 == 0) {
+                small.push_back(i);
+                std_small.push_back(i);
+            } else {
+                small.push_front(i);
+                std_small.push_front(i);
+            }
+        }
+        REQUIRE(small.is_inline());
+        REQUIRE(std::equal(small.begin(), small.end(), std_small.begin(), std_small.end()));
+        // Spills on the 17th element, order is kept
+        small.push_front(small.back());
+        std_small.push_front(std_small.back());
+        REQUIRE_FALSE(small.is_inline());
+        for (int i = 0; i < 1000; ++i) {
+            small.push_back(i);
+            std_small.push_back(i);
+        }
+        REQUIRE(std::equal(small.begin(), small.end(), std_small.begin(), std_small.end()));
+        REQUIRE(std::equal(small.rbegin(), small.rend(), std_small.rbegin(), std_small.rend()));
+        REQUIRE(small[500] == std_small[500]);
+        small.clear();
+        REQUIRE(small.empty());
+        REQUIRE_FALSE(small.is_inline());
+        REQUIRE_THROWS_AS(small.pop_back(), std::runtime_error);
+
+        SmallDeque<std::string, 4> words = {"a", "b", "c"};
+        SmallDeque<std::string, 4> words_copy(words);
+        REQUIRE(words_copy == words);
+        words.emplace_back(40, 'x');
+        words.emplace_front(words.back());
+        REQUIRE_FALSE(words.is_inline());
+        REQUIRE(words.size() == 5);
+        REQUIRE(words.front() == std::string(40, 'x'));
+        REQUIRE(words_copy < words);
+        SmallDeque<std::string, 4> words_moved(std::move(words));
+        REQUIRE(words.empty());
+        REQUIRE(words.is_inline());
+        REQUIRE(words_moved.at(1) == "a");
+        words = words_moved;
+        swap(words, words_copy);
+        REQUIRE(words.size() == 3);
+        REQUIRE(words_copy == words_moved);
+        std::sort(words_copy.begin(), words_copy.end());
+        REQUIRE(words_copy.back() == std::string(40, 'x'));
+
+        // Move assignment from an inline deque whose move throws leaves an
+        // empty inline deque (double destruction is checked by sanitizers)
+        struct MoveThrower {
+            std::string value;
+            bool* is_throwing = nullptr;
+            MoveThrower(std::string val, bool* throwing)
+                    : value(std::move(val)), is_throwing(throwing) {}
+            MoveThrower(const MoveThrower&) = default;
+            MoveThrower(MoveThrower&& other) : value(other.value), is_throwing(other.is_throwing) {
+                if (*is_throwing) {
+                    throw std::runtime_error("move");
+                }
+            }
+            MoveThrower& operator=(const MoveThrower&) = default;
+        };
+        bool is_throwing = false;
+        SmallDeque<MoveThrower, 4> spilled;
+        for (int i = 0; i < 10; ++i) {
+            spilled.emplace_back(std::string(40, 'a'), &is_throwing);
+        }
+        REQUIRE_FALSE(spilled.is_inline());
+        SmallDeque<MoveThrower, 4> inline_throwers;
+        inline_throwers.emplace_back(std::string(40, 'b'), &is_throwing);
+        is_throwing = true;
+        REQUIRE_THROWS_AS(spilled = std::move(inline_throwers), std::runtime_error);
+        is_throwing = false;
+        REQUIRE(spilled.is_inline());
+        REQUIRE(spilled.empty());
+        spilled.emplace_back(std::string(40, 'c'), &is_throwing);
+        REQUIRE(spilled.back().value == std::string(40, 'c'));
+    }
+
+    SECTION("Lazy default construction") {
+        int64_t counter = 0;
+        typedef Deque<int, CountingAllocator<int>> CountingDeque;
+        {
+            CountingDeque d{CountingAllocator<int>(&counter)};
+            REQUIRE(d.empty());
+            REQUIRE(d.size() == 0);
+            REQUIRE(d.begin() == d.end());
+            REQUIRE(d.capacity_front() == 0);
+            REQUIRE(d.capacity_back() == 0);
+            CountingDeque copy(d);
+            CountingDeque moved(std::move(copy));
+            d.clear();
+            d.shrink_to_fit();
+            d.pop_back(0);
+            d.resize(0);
+            d.assign({});
+            d.append_back({});
+            REQUIRE(d == moved);
+            REQUIRE(std::accumulate(d.begin(), d.end(), 0) == 0);
+            REQUIRE(deque_algo::count(d.cbegin(), d.cend(), 0) == 0);
+            REQUIRE(d.compact_begin() == d.compact_end());
+            int64_t spans = 0;
+            for (DequeSpan<int> span : d.segments()) {
+                spans += 1 + span.size();
+            }
+            REQUIRE(spans == 0);
+            REQUIRE_THROWS_AS(d.pop_front(), std::runtime_error);
+        }
+        REQUIRE(counter == 0);
+
+        // Every way in allocates on first use
+        CountingDeque front{CountingAllocator<int>(&counter)};
+        front.push_front(1);
+        front.push_back(2);
+        REQUIRE(front == CountingDeque({1, 2}, CountingAllocator<int>(&counter)));
+        REQUIRE(counter > 0);
+        Deque<int> back;
+        back.emplace_back(1);
+        back.emplace_front(0);
+        REQUIRE(back == Deque<int>{0, 1});
+        Deque<int, std::allocator<int>, DequeBlockElems<1>> single_front, single_back;
+        single_front.push_front(1);
+        single_front.push_front(0);
+        single_back.push_back(0);
+        single_back.push_back(1);
+        REQUIRE(single_front == single_back);
+        REQUIRE(single_back.size() == 2);
+        Deque<int> inserted;
+        inserted.insert(inserted.begin(), {1, 2, 3});
+        inserted.insert(inserted.end(), 2, 4);
+        REQUIRE(inserted == Deque<int>{1, 2, 3, 4, 4});
+        Deque<int> appended, reserved, resized;
+        appended.append_front({1, 2});
+        reserved.reserve_front(10);
+        REQUIRE(reserved.capacity_front() >= 10);
+        resized.resize(3000, 5);
+        REQUIRE(appended.back() == 2);
+        REQUIRE(resized.size() == 3000);
+
+        // A moved-from deque is an empty lazy deque again
+        Deque<std::string> words = {"a", "b"};
+        Deque<std::string> taken(std::move(words));
+        REQUIRE(words.size() == 0);
+        words.push_back("c");
+        REQUIRE(words.front() == "c");
+        REQUIRE(taken.size() == 2);
+    }
+
+    SECTION("Work-stealing deque") {
+        WorkStealingDeque<int64_t, DequeBlockElems<4>> tasks;
+        REQUIRE(tasks.capacity() == 8);
+        REQUIRE_FALSE(tasks.pop_back());
+        REQUIRE_FALSE(tasks.steal());
+        for (int64_t i = 0; i < 1000; ++i) {
+            tasks.push_back(i);
+        }
+        REQUIRE(tasks.size() == 1000);
+        REQUIRE(tasks.capacity() >= 1000);
+        REQUIRE(*tasks.pop_back() == 999);
+        REQUIRE(*tasks.steal() == 0);
+        // Growth with the ring wrapped: both ends share a block
+        for (int64_t i = 1; i < 998; ++i) {
+            REQUIRE(*tasks.steal() == i);
+        }
+        for (int64_t i = 0; i < 5000; ++i) {
+            tasks.push_back(i);
+        }
+        REQUIRE(*tasks.steal() == 998);
+        for (int64_t i = 0; i < 5000; ++i) {
+            REQUIRE(*tasks.steal() == i);
+        }
+        REQUIRE(tasks.empty());
+
+        // Owner pushes and pops, thieves steal: every task is taken once
+        const int64_t kTasks = 200'000;
+        const int kThieves = 3;
+        WorkStealingDeque<int64_t, DequeBlockElems<4>> shared;
+        std::atomic<bool> done{false};
+        std::vector<std::vector<int64_t>> taken(kThieves + 1);
+        std::vector<std::thread> thieves;
+        for (int thief = 0; thief < kThieves; ++thief) {
+            thieves.emplace_back([&, thief] {
+                while (true) {
+                    bool finished = done.load(std::memory_order_acquire);
+                    if (auto task = shared.steal()) {
+                        taken[thief].push_back(*task);
+                    } else if (finished && shared.empty()) {
+                        break;
+                    }
+                }
+            });
+        }
+        for (int64_t i = 0; i < kTasks; ++i) {
+            shared.push_back(i);
+            if (i % 3 == 0) {
+                if (auto task = shared.pop_back()) {
+                    taken[kThieves].push_back(*task);
+                }
+            }
+        }
+        while (auto task = shared.pop_back()) {
+            taken[kThieves].push_back(*task);
+        }
+        done.store(true, std::memory_order_release);
+        for (std::thread& thief : thieves) {
+            thief.join();
+        }
+        std::vector<int64_t> all;
+        for (const auto& part : taken) {
+            all.insert(all.end(), part.begin(), part.end());
+        }
+        std::sort(all.begin(), all.end());
+        std::vector<int64_t> expected(kTasks);
+        std::iota(expected.begin(), expected.end(), 0);
+        REQUIRE(all == expected);
+    }
+
+    SECTION("SPSC deque") {
+        SpscDeque<std::string, DequeBlockElems<4>> words;
+        REQUIRE_FALSE(words.pop_front());
+        for (int i = 0; i < 10; ++i) {
+            words.push_back(std::to_string(i));
+        }
+        REQUIRE(words.size() == 10);
+        for (int i = 0; i < 10; ++i) {
+            REQUIRE(*words.pop_front() == std::to_string(i));
+        }
+        REQUIRE(words.empty());
+        // Bounded depth: drained blocks are recycled, not reallocated
+        int64_t blocks = words.block_count();
+        for (int i = 0; i < 1000; ++i) {
+            words.emplace_back(30, 'a');
+            words.emplace_back(30, 'b');
+            REQUIRE(*words.pop_front() == std::string(30, 'a'));
+            REQUIRE(*words.pop_front() == std::string(30, 'b'));
+        }
+        REQUIRE(words.block_count() <= blocks + 2);
+        // Elements left at destruction are destroyed (checked by sanitizers)
+        words.push_back("left");
+
+        // A throwing move at a block boundary leaves the element in place
+        struct MoveThrower {
+            int value;
+            bool* is_throwing;
+
+            MoveThrower(int val, bool* throwing) : value(val), is_throwing(throwing) {}
+            MoveThrower(MoveThrower&& other) : value(other.value), is_throwing(other.is_throwing) {
+                if (*is_throwing) {
+                    throw std::runtime_error("MoveThrower");
+                }
+            }
+        };
+        bool is_throwing = false;
+        SpscDeque<MoveThrower, DequeBlockElems<4>> throwers;
+        for (int i = 0; i < 12; ++i) {
+            throwers.emplace_back(i, &is_throwing);
+        }
+        for (int i = 0; i < 4; ++i) {
+            REQUIRE(throwers.pop_front()->value == i);
+        }
+        is_throwing = true;
+        REQUIRE_THROWS_AS(throwers.pop_front(), std::runtime_error);
+        is_throwing = false;
+        // Producer must not recycle the block the element stayed in
+        for (int i = 12; i < 20; ++i) {
+            throwers.emplace_back(i, &is_throwing);
+        }
+        for (int i = 4; i < 20; ++i) {
+            REQUIRE(throwers.pop_front()->value == i);
+        }
+        REQUIRE_FALSE(throwers.pop_front());
+
+        const int64_t kItems = 500'000;
+        SpscDeque<int64_t, DequeBlockElems<16>> channel;
+        bool in_order = true;
+        std::thread consumer([&] {
+            int64_t expected = 0;
+            while (expected < kItems) {
+                if (auto item = channel.pop_front()) {
+                    in_order = in_order && *item == expected;
+                    ++expected;
+                }
+            }
+        });
+        for (int64_t i = 0; i < kItems; ++i) {
+            channel.push_back(i);
+        }
+        consumer.join();
+        REQUIRE(in_order);
+        REQUIRE(channel.empty());
+    }
+    SECTION("Concurrent deque") {
+        ConcurrentDeque<std::string, DequeBlockElems<4>> words;
+        REQUIRE_FALSE(words.pop_front());
+        REQUIRE(words.empty());
+        for (int i = 0; i < 10; ++i) {
+            words.push_back(std::to_string(i));
+        }
+        REQUIRE_FALSE(words.empty());
+        for (int i = 0; i < 10; ++i) {
+            REQUIRE(*words.pop_front() == std::to_string(i));
+        }
+        REQUIRE_FALSE(words.pop_front());
+        // Drained segments are retired and freed (checked by sanitizers),
+        // elements left at destruction are destroyed
+        for (int i = 0; i < 1000; ++i) {
+            words.emplace_back(30, 'a');
+            REQUIRE(*words.pop_front() == std::string(30, 'a'));
+        }
+        words.push_back("left");
+
+        const int kProducers = 4;
+        const int kConsumers = 4;
+        const int64_t kItemsPerProducer = 50'000;
+        ConcurrentDeque<int64_t, DequeBlockElems<8>> queue;
+        std::atomic<int64_t> received{0};
+        std::vector<std::vector<int64_t>> taken(kConsumers);
+        std::vector<std::thread> threads;
+        for (int producer = 0; producer < kProducers; ++producer) {
+            threads.emplace_back([&, producer] {
+                for (int64_t i = 0; i < kItemsPerProducer; ++i) {
+                    queue.push_back(producer * kItemsPerProducer + i);
+                }
+            });
+        }
+        for (int consumer = 0; consumer < kConsumers; ++consumer) {
+            threads.emplace_back([&, consumer] {
+                while (received.load() < kProducers * kItemsPerProducer) {
+                    if (auto item = queue.pop_front()) {
+                        taken[consumer].push_back(*item);
+                        ++received;
+                    } else {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        REQUIRE(queue.empty());
+        // FIFO: each consumer sees every producer's items in push order
+        bool in_order = true;
+        std::vector<int64_t> all;
+        for (const std::vector<int64_t>& items : taken) {
+            std::vector<int64_t> last(kProducers, -1);
+            for (int64_t item : items) {
+                int64_t producer = item / kItemsPerProducer;
+                in_order = in_order && item > last[producer];
+                last[producer] = item;
+            }
+            all.insert(all.end(), items.begin(), items.end());
+        }
+        REQUIRE(in_order);
+        std::sort(all.begin(), all.end());
+        std::vector<int64_t> expected(kProducers * kItemsPerProducer);
+        std::iota(expected.begin(), expected.end(), 0);
+        REQUIRE(all == expected);
+    }
+}
@@ -0,0 +1,159 @@
+#ifndef MYDEQUE_SPSC_H
+#define MYDEQUE_SPSC_H
+
+#include "deque.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// Unbounded single-producer single-consumer FIFO on linked Deque-sized
+// blocks. The producer appends at the back, the consumer drains the front;
+// no read-modify-write atomics on either side.
+//
+// Each side publishes its position with a release store and reads the other
+// side's with an acquire load only when its cached copy runs out. Blocks the
+// consumer has left are recycled by the producer: it owns the oldest block
+// and reuses it once the consumer's published block is past it.
+template<typename T, typename BlockPolicy = DequeDefaultBlock>
+class SpscDeque {
+  public:
+    typedef T value_type;
+    typedef BlockPolicy block_policy;
+
+  private:
+    typedef DequeBlockMath<DequeRoundUpPow2(BlockPolicy::template kElems<T>)> block_math;
+
+    static constexpr int64_t kBlockSize = DequeRoundUpPow2(BlockPolicy::template kElems<T>);
+
+    struct Block {
+        std::atomic<Block*> next{nullptr};
+        alignas(T) unsigned char slots[kBlockSize * sizeof(T)];
+
+        T* Slot(int64_t pos) noexcept {
+            return reinterpret_cast<T*>(slots) + (pos & block_math::kMask);
+        }
+    };
+
+  public:
+    SpscDeque()
+            : oldest_block_(new Block)
+            , back_block_(oldest_block_)
+            , front_block_(oldest_block_) {
+        consumer_block_.store(oldest_block_, std::memory_order_relaxed);
+    }
+    SpscDeque(const SpscDeque&) = delete;
+    SpscDeque& operator=(const SpscDeque&) = delete;
+    // No thread may use the deque any more
+    ~SpscDeque() {
+        int64_t back = back_.load(std::memory_order_acquire);
+        while (front_pos_ != back) {
+            if ((front_pos_ & block_math::kMask) == 0 && front_pos_ != 0) {
+                front_block_ = front_block_->next.load(std::memory_order_relaxed);
+            }
+            front_block_->Slot(front_pos_)->~T();
+            ++front_pos_;
+        }
+        while (oldest_block_ != nullptr) {
+            delete std::exchange(oldest_block_,
+                                 oldest_block_->next.load(std::memory_order_relaxed));
+        }
+    }
+
+    // Producer only
+    void push_back(const T& val) {
+        emplace_back(val);
+    }
+    void push_back(T&& val) {
+        emplace_back(std::move(val));
+    }
+    template<typename... Args>
+    void emplace_back(Args&&... args) {
+        Block* block = back_block_;
+        if ((back_pos_ & block_math::kMask) == 0 && back_pos_ != 0) {
+            // Linked before construction, so a throwing constructor leaves
+            // it for the next push
+            block = back_block_->next.load(std::memory_order_relaxed);
+            if (block == nullptr) {
+                block = TakeBlock();
+                back_block_->next.store(block, std::memory_order_release);
+            }
+        }
+        ::new (static_cast<void*>(block->Slot(back_pos_))) T(std::forward<Args>(args)...);
+        back_block_ = block;
+        back_.store(++back_pos_, std::memory_order_release);
+    }
+
+    // Consumer only: the oldest element, none if the deque is empty
+    std::optional<T> pop_front() {
+        if (front_pos_ == cached_back_) {
+            cached_back_ = back_.load(std::memory_order_acquire);
+            if (front_pos_ == cached_back_) {
+                return std::nullopt;
+            }
+        }
+        Block* block = front_block_;
+        bool is_new_block = (front_pos_ & block_math::kMask) == 0 && front_pos_ != 0;
+        if (is_new_block) {
+            block = front_block_->next.load(std::memory_order_acquire);
+        }
+        T* slot = block->Slot(front_pos_);
+        std::optional<T> val(std::move(*slot));
+        slot->~T();
+        if (is_new_block) {
+            // Block boundary, the element is out: the old block goes back to
+            // the producer (a throwing move leaves the state as it was)
+            front_block_ = block;
+            consumer_block_.store(block, std::memory_order_release);
+        }
+        front_.store(++front_pos_, std::memory_order_release);
+        return val;
+    }
+
+    // Snapshot, exact only when neither side is running
+    int64_t size() const noexcept {
+        int64_t front = front_.load(std::memory_order_acquire);
+        return back_.load(std::memory_order_acquire) - front;
+    }
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+    // Producer only: blocks allocated so far (recycled blocks are not new)
+    int64_t block_count() const noexcept {
+        return block_count_;
+    }
+    static constexpr int64_t block_size() noexcept {
+        return kBlockSize;
+    }
+
+  private:
+    // Producer side
+    alignas(kDequeCacheLine) Block* oldest_block_;
+    Block* back_block_;
+    int64_t back_pos_{0};
+    int64_t block_count_{1};
+    alignas(kDequeCacheLine) std::atomic<int64_t> back_{0};
+    // Consumer side
+    alignas(kDequeCacheLine) Block* front_block_;
+    int64_t front_pos_{0};
+    int64_t cached_back_{0};
+    alignas(kDequeCacheLine) std::atomic<int64_t> front_{0};
+    alignas(kDequeCacheLine) std::atomic<Block*> consumer_block_{nullptr};
+
+    // Oldest block if the consumer is done with it, a new one otherwise
+    Block* TakeBlock() {
+        if (oldest_block_ != consumer_block_.load(std::memory_order_acquire)) {
+            Block* block = oldest_block_;
+            oldest_block_ = block->next.load(std::memory_order_relaxed);
+            block->next.store(nullptr, std::memory_order_relaxed);
+            return block;
+        }
+        ++block_count_;
+        return new Block;
+    }
+};
+
+#endif /* MYDEQUE_SPSC_H */
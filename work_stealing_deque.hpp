@@ -0,0 +1,191 @@
+#ifndef MYDEQUE_WORK_STEALING_H
+#define MYDEQUE_WORK_STEALING_H
+
+#include "deque.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+// Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli, PPoPP'13)
+// on the Deque block layout. The owner thread pushes and pops at the back,
+// any thread steals from the front.
+//
+// Element i lives in block (i >> shift) & map mask, slot i & block mask:
+// the map of blocks is a ring, one array of capacity map_size * block_size.
+// When it is full the owner publishes a map twice as large that points to
+// the same blocks, so growth copies block pointers, not elements. The only
+// exception is a block that holds both ends of the full ring: it gets two
+// fresh copies and is never written again.
+//
+// Reclamation: a thief may still read through a replaced map, and a
+// replaced (split) block, so they are kept until the deque is destroyed.
+// Maps double, hence all retired maps together are smaller than the live one.
+template<typename T, typename BlockPolicy = DequeDefaultBlock>
+class WorkStealingDeque {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "WorkStealingDeque: thieves may read a slot while it is reused, "
+                  "elements must be trivially copyable");
+
+  public:
+    typedef T value_type;
+    typedef BlockPolicy block_policy;
+
+  private:
+    typedef std::atomic<T> Slot;
+    typedef DequeBlockMath<DequeRoundUpPow2(BlockPolicy::template kElems<T>)> block_math;
+
+    static constexpr int64_t kBlockSize = DequeRoundUpPow2(BlockPolicy::template kElems<T>);
+    static constexpr int64_t kInitMapSize = 2;
+
+    struct BlockMap {
+        explicit BlockMap(int64_t size)
+                : mask(size - 1)
+                , blocks(new Slot*[size]()) {}
+
+        int64_t mask;
+        std::unique_ptr<Slot*[]> blocks;
+
+        Slot& At(int64_t ind) const noexcept {
+            return blocks[(ind >> block_math::kShift) & mask][ind & block_math::kMask];
+        }
+        int64_t Capacity() const noexcept {
+            return (mask + 1) * kBlockSize;
+        }
+    };
+
+  public:
+    WorkStealingDeque() {
+        std::unique_ptr<BlockMap> map(new BlockMap(kInitMapSize));
+        for (int64_t i = 0; i < kInitMapSize; ++i) {
+            map->blocks[i] = NewBlock();
+        }
+        map_.store(map.get(), std::memory_order_relaxed);
+        maps_.push_back(std::move(map));
+    }
+    WorkStealingDeque(const WorkStealingDeque&) = delete;
+    WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+    // Owner only
+    void push_back(const T& val) {
+        int64_t back = back_.load(std::memory_order_relaxed);
+        int64_t front = front_.load(std::memory_order_acquire);
+        BlockMap* map = map_.load(std::memory_order_relaxed);
+        if (back - front >= map->Capacity()) {
+            map = Grow(map, front, back);
+        }
+        map->At(back).store(val, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        back_.store(back + 1, std::memory_order_relaxed);
+    }
+    // Owner only: the newest element, none if the deque is empty
+    // (or a thief took the last one)
+    std::optional<T> pop_back() {
+        int64_t back = back_.load(std::memory_order_relaxed) - 1;
+        BlockMap* map = map_.load(std::memory_order_relaxed);
+        back_.store(back, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t front = front_.load(std::memory_order_relaxed);
+        if (front > back) {
+            back_.store(back + 1, std::memory_order_relaxed);
+            return std::nullopt;
+        }
+        T val = map->At(back).load(std::memory_order_relaxed);
+        if (front == back) {
+            // Last element: race against thieves for it
+            bool won = front_.compare_exchange_strong(front, front + 1,
+                                                      std::memory_order_seq_cst,
+                                                      std::memory_order_relaxed);
+            back_.store(back + 1, std::memory_order_relaxed);
+            if (!won) {
+                return std::nullopt;
+            }
+        }
+        return val;
+    }
+    // Any thread: the oldest element. None if the deque is empty or another
+    // thread won the race for that element (callers simply retry)
+    std::optional<T> steal() {
+        int64_t front = front_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t back = back_.load(std::memory_order_acquire);
+        if (front >= back) {
+            return std::nullopt;
+        }
+        BlockMap* map = map_.load(std::memory_order_acquire);
+        T val = map->At(front).load(std::memory_order_relaxed);
+        if (!front_.compare_exchange_strong(front, front + 1, std::memory_order_seq_cst,
+                                            std::memory_order_relaxed)) {
+            return std::nullopt;
+        }
+        return val;
+    }
+
+    // Snapshot, exact only when no other thread works on the deque
+    int64_t size() const noexcept {
+        int64_t back = back_.load(std::memory_order_acquire);
+        int64_t front = front_.load(std::memory_order_acquire);
+        return back > front ? back - front : 0;
+    }
+    bool empty() const noexcept {
+        return size() == 0;
+    }
+    // Owner only
+    int64_t capacity() const noexcept {
+        return map_.load(std::memory_order_relaxed)->Capacity();
+    }
+    static constexpr int64_t block_size() noexcept {
+        return kBlockSize;
+    }
+
+  private:
+    // Indices only grow; front_ is written by thieves, back_ by the owner
+    alignas(kDequeCacheLine) std::atomic<int64_t> front_{0};
+    alignas(kDequeCacheLine) std::atomic<int64_t> back_{0};
+    alignas(kDequeCacheLine) std::atomic<BlockMap*> map_{nullptr};
+    // Owner only: every block and map ever published
+    std::vector<std::unique_ptr<Slot[]>> blocks_;
+    std::vector<std::unique_ptr<BlockMap>> maps_;
+
+    Slot* NewBlock() {
+        blocks_.emplace_back(new Slot[kBlockSize]);
+        return blocks_.back().get();
+    }
+    // Ring [front, back) is full: blocks keep their place in the twice
+    // larger map, a block shared by both ends is split into two copies
+    BlockMap* Grow(BlockMap* map, int64_t front, int64_t back) {
+        std::unique_ptr<BlockMap> grown(new BlockMap(2 * (map->mask + 1)));
+        int64_t first_block = front >> block_math::kShift;
+        int64_t last_block = (back - 1) >> block_math::kShift;
+        bool is_split = last_block - first_block == map->mask + 1;
+        for (int64_t block = first_block; block <= last_block; ++block) {
+            Slot* old_block = map->blocks[block & map->mask];
+            if (is_split && (block == first_block || block == last_block)) {
+                Slot* copy = NewBlock();
+                int64_t from = std::max(front, block << block_math::kShift);
+                int64_t to = std::min(back, (block + 1) << block_math::kShift);
+                for (int64_t ind = from; ind < to; ++ind) {
+                    copy[ind & block_math::kMask].store(
+                            old_block[ind & block_math::kMask].load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+                }
+                old_block = copy;
+            }
+            grown->blocks[block & grown->mask] = old_block;
+        }
+        for (int64_t i = 0; i <= grown->mask; ++i) {
+            if (grown->blocks[i] == nullptr) {
+                grown->blocks[i] = NewBlock();
+            }
+        }
+        map_.store(grown.get(), std::memory_order_release);
+        maps_.push_back(std::move(grown));
+        return maps_.back().get();
+    }
+};
+
+#endif /* MYDEQUE_WORK_STEALING_H */